@@ -0,0 +1,69 @@
+#include <cstdint>
+#include <cstdlib>
+#include "arena.hpp"
+
+namespace drewno_mars{
+
+Arena::Arena(size_t blockSizeIn) : myBlockSize(blockSizeIn){ }
+
+Arena::~Arena(){
+	reset();
+	for (auto block : myBlocks){ std::free(block); }
+	if (myProfile != nullptr){ myProfile->release(myReserved); }
+}
+
+void Arena::newBlock(size_t minSize){
+	size_t size = minSize > myBlockSize ? minSize : myBlockSize;
+	char * block = static_cast<char *>(std::malloc(size));
+	if (block == nullptr){ throw std::bad_alloc(); }
+	if (myBlocks.empty()){ myFirstSize = size; }
+	myBlocks.push_back(block);
+	myReserved += size;
+	if (myProfile != nullptr){ myProfile->reserve(size); }
+	myCur = block;
+	myEnd = block + size;
+}
+
+void Arena::setProfile(ArenaProfile * profile){
+	if (myProfile != nullptr){ myProfile->release(myReserved); }
+	myProfile = profile;
+	if (myProfile != nullptr){ myProfile->reserve(myReserved); }
+}
+
+void * Arena::carve(size_t size, size_t align){
+	uintptr_t cur = reinterpret_cast<uintptr_t>(myCur);
+	size_t pad = (align - cur % align) % align;
+	if (myCur == nullptr
+	    || static_cast<size_t>(myEnd - myCur) < size + pad){
+		/* malloc'd blocks are aligned for any fundamental type,
+		   so a fresh block never needs padding */
+		newBlock(size);
+		pad = 0;
+	}
+	char * result = myCur + pad;
+	myCur = result + size;
+	myUsed += size + pad;
+	return result;
+}
+
+void Arena::reset(){
+	for (auto it = myCleanups.rbegin(); it != myCleanups.rend(); ++it){
+		it->fn(it->obj);
+	}
+	myCleanups.clear();
+	if (myBlocks.empty()){ return; }
+
+	for (size_t i = 1; i < myBlocks.size(); i++){
+		std::free(myBlocks[i]);
+	}
+	myBlocks.resize(1);
+	if (myProfile != nullptr){
+		myProfile->release(myReserved - myFirstSize);
+	}
+	myReserved = myFirstSize;
+	myCur = myBlocks[0];
+	myEnd = myCur + myFirstSize;
+	myUsed = 0;
+}
+
+}
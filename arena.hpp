@@ -0,0 +1,147 @@
+#ifndef DREWNO_MARS_ARENA_H
+#define DREWNO_MARS_ARENA_H
+
+#include <cstddef>
+#include <cstring>
+#include <map>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace drewno_mars{
+
+/**
+* \class ArenaProfile
+* A count and byte total, per category, of what an Arena given this
+* profile hands out, along with the blocks it reserves to do so.
+* Categories are static strings; an object's is arenaCategory(obj),
+* found by argument-dependent lookup, so each kind of object names
+* itself next to its own definition.
+**/
+class ArenaProfile{
+public:
+	struct Tally{
+		size_t count = 0;
+		size_t bytes = 0;
+	};
+	struct NameLess{
+		bool operator()(const char * a, const char * b) const {
+			return std::strcmp(a, b) < 0;
+		}
+	};
+	using Tallies = std::map<const char *, Tally, NameLess>;
+
+	void record(const char * category, size_t bytes){
+		Tally& tally = myTallies[category];
+		tally.count++;
+		tally.bytes += bytes;
+		myBytes += bytes;
+	}
+	void reserve(size_t bytes){
+		myReserved += bytes;
+		if (myReserved > myPeak){ myPeak = myReserved; }
+	}
+	void release(size_t bytes){ myReserved -= bytes; }
+
+	const Tallies& tallies() const { return myTallies; }
+	/** Bytes handed out, over every category **/
+	size_t bytes() const { return myBytes; }
+	/** Block bytes held now, and the most ever held at once **/
+	size_t reserved() const { return myReserved; }
+	size_t peak() const { return myPeak; }
+private:
+	Tallies myTallies;
+	size_t myBytes = 0;
+	size_t myReserved = 0;
+	size_t myPeak = 0;
+};
+
+/* The category of anything without one of its own */
+inline const char * arenaCategory(const void *){ return "other"; }
+
+/**
+* \class Arena
+* A bump allocator that owns every ASTNode and NodeList built
+* during one compilation. Objects are carved out of large blocks and
+* are never freed one at a time; reset() (or destroying the arena)
+* releases all of them at once.
+**/
+class Arena{
+public:
+	Arena(size_t blockSizeIn = 64 * 1024);
+	~Arena();
+	Arena(const Arena&) = delete;
+	Arena& operator=(const Arena&) = delete;
+
+	/** Raw, uninitialized storage that lives until the next reset,
+	    tallied under category if there is a profile **/
+	void * allocate(size_t size, size_t align,
+	  const char * category = "untyped"){
+		if (myProfile != nullptr){ myProfile->record(category, size); }
+		return carve(size, align);
+	}
+
+	/** Construct a T in the arena. If T has a non-trivial destructor
+	    (e.g. it holds a std::string) it is queued to
+	    be run on reset. **/
+	template <typename T, typename... Args>
+	T * make(Args&&... args){
+		void * mem = carve(sizeof(T), alignof(T));
+		T * obj = new (mem) T(std::forward<Args>(args)...);
+		addCleanup(obj, std::is_trivially_destructible<T>());
+		if (myProfile != nullptr){
+			myProfile->record(arenaCategory(obj), sizeof(T));
+		}
+		return obj;
+	}
+
+	/** Tally every allocation from now on into profile, or stop
+	    if it is null **/
+	void setProfile(ArenaProfile * profile);
+
+	/** Destroy every object and give back all but the first block **/
+	void reset();
+
+	/** Bytes handed out since the last reset **/
+	size_t bytesUsed() const { return myUsed; }
+	/** Bytes currently reserved from the system **/
+	size_t bytesReserved() const { return myReserved; }
+private:
+	struct Cleanup{
+		void (*fn)(void *);
+		void * obj;
+	};
+
+	template <typename T>
+	static void destroy(void * obj){
+		static_cast<T *>(obj)->~T();
+	}
+
+	template <typename T>
+	void addCleanup(T *, std::true_type){ }
+
+	template <typename T>
+	void addCleanup(T * obj, std::false_type){
+		myCleanups.push_back(Cleanup{&destroy<T>, obj});
+	}
+
+	void * carve(size_t size, size_t align);
+	void newBlock(size_t minSize);
+
+	const size_t myBlockSize;
+	std::vector<char *> myBlocks;
+	std::vector<Cleanup> myCleanups;
+	/* Size of myBlocks[0], which is bigger than myBlockSize when
+	   the first thing carved was */
+	size_t myFirstSize = 0;
+	char * myCur = nullptr;
+	char * myEnd = nullptr;
+	size_t myUsed = 0;
+	size_t myReserved = 0;
+	ArenaProfile * myProfile = nullptr;
+};
+
+}
+
+#endif
@@ -1,11 +1,40 @@
 #include "ast.hpp"
 
-drewno_mars::ProgramNode::ProgramNode(std::list<DeclNode *> * globalsIn)
-: ASTNode(new Position(0,0,0,0)), myGlobals(globalsIn){
+drewno_mars::ProgramNode::ProgramNode(NodeList<DeclNode *> * globalsIn)
+: ASTNode(NodeKind::PROGRAM, Position(0,0,0,0)), myGlobals(globalsIn){
 	if (!globalsIn->empty()){
-		myPos = new Position(
+		myPos.expand(
 			myGlobals->front()->pos(),
 			myGlobals->back()->pos()
 		);
 	}
 }
+
+const char * drewno_mars::nodeKindName(NodeKind k){
+	static const char * const names[] = {
+		"?", "ProgramNode",
+		"IntTypeNode", "BoolTypeNode", "VoidTypeNode", "ClassTypeNode",
+		"PerfectTypeNode",
+		"AssignStmtNode", "CallStmtNode", "ExitStmtNode", "GiveStmtNode",
+		"IfElseStmtNode", "IfStmtNode", "PostDecStmtNode",
+		"PostIncStmtNode", "ReturnStmtNode", "TakeStmtNode",
+		"WhileStmtNode",
+		"VarDeclNode", "FormalDeclNode", "FnDeclNode", "ClassDeclNode",
+		"IDNode", "MemberFieldExpNode",
+		"CallExpNode", "FalseNode", "TrueNode", "MagicNode", "IntLitNode",
+		"StrLitNode",
+		"NegNode", "NotNode",
+		"AndNode", "DivideNode", "EqualsNode", "GreaterEqNode",
+		"GreaterNode", "LessNode", "LessEqNode", "MinusNode",
+		"NotEqualsNode", "OrNode", "PlusNode", "TimesNode"
+	};
+	static_assert(sizeof(names) / sizeof(names[0])
+	  == static_cast<size_t>(NodeKind::TIMES) + 1, "a kind has no name");
+	size_t index = static_cast<size_t>(k);
+	if (index >= sizeof(names) / sizeof(names[0])){ return "?"; }
+	return names[index];
+}
+
+const char * drewno_mars::arenaCategory(const ASTNode * node){
+	return nodeKindName(node->kind());
+}
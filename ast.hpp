@@ -1,9 +1,11 @@
 #ifndef DREWNO_MARS_AST_HPP
 #define DREWNO_MARS_AST_HPP
 
+#include <cstdint>
 #include <ostream>
-#include <list>
 #include "tokens.hpp"
+#include "nodelist.hpp"
+#include "writer.hpp"
 #include <cassert>
 
 
@@ -20,21 +22,77 @@ class StmtNode;
 class IDNode;
 class LocNode;
 
-/** 
+/* The concrete class of a node. Each category of nodes is one
+   contiguous range, so the is...() tests below are two compares.
+   AST files store these numbers: reordering them means bumping
+   the format version in serialize.cpp. */
+enum class NodeKind : uint8_t {
+	PROGRAM = 1,
+	// Types
+	INT_TYPE, BOOL_TYPE, VOID_TYPE, CLASS_TYPE, PERFECT_TYPE,
+	// Statements, with the declarations last
+	ASSIGN, CALL_STMT, EXIT, GIVE, IF_ELSE, IF, POST_DEC, POST_INC,
+	RETURN, TAKE, WHILE,
+	VAR_DECL, FORMAL_DECL, FN_DECL, CLASS_DECL,
+	// Expressions, with the locations first
+	ID, MEMBER_FIELD,
+	CALL_EXP, FALSE_LIT, TRUE_LIT, MAGIC, INT_LIT, STR_LIT,
+	NEG, NOT,
+	AND, DIVIDE, EQUALS, GREATER_EQ, GREATER, LESS, LESS_EQ, MINUS,
+	NOT_EQUALS, OR, PLUS, TIMES
+};
+
+inline bool isType(NodeKind k){
+	return k >= NodeKind::INT_TYPE && k <= NodeKind::PERFECT_TYPE;
+}
+inline bool isStmt(NodeKind k){
+	return k >= NodeKind::ASSIGN && k <= NodeKind::CLASS_DECL;
+}
+inline bool isDecl(NodeKind k){
+	return k >= NodeKind::VAR_DECL && k <= NodeKind::CLASS_DECL;
+}
+inline bool isExp(NodeKind k){
+	return k >= NodeKind::ID && k <= NodeKind::TIMES;
+}
+inline bool isLoc(NodeKind k){
+	return k == NodeKind::ID || k == NodeKind::MEMBER_FIELD;
+}
+inline bool isBinaryExp(NodeKind k){
+	return k >= NodeKind::AND && k <= NodeKind::TIMES;
+}
+
+/* The name of the class a kind of node has, e.g. "IDNode" */
+const char * nodeKindName(NodeKind k);
+
+class ASTNode;
+/* Nodes are tallied in an ArenaProfile by their class */
+const char * arenaCategory(const ASTNode * node);
+
+/**
 * \class ASTNode
-* Base class for all other AST Node types
+* Base class for all other AST Node types. There are no virtual
+* methods: passes switch on kind(), usually through the ASTVisitor
+* in visitor.hpp.
 **/
 class ASTNode{
 public:
-	ASTNode(const Position * p) : myPos(p){ }
-	virtual void unparse(std::ostream& out, int indent) = 0;
-	const Position * pos() { return myPos; }
-	std::string posStr() { return pos()->span(); }
+	ASTNode(NodeKind kind, const Position& p) : myPos(p), myKind(kind){ }
+	NodeKind kind() const { return myKind; }
+	/** Write the canonical program form (see unparse.cpp) **/
+	void unparse(Writer& out, int indent);
+	/** Unparse into a stream, buffering through a Writer **/
+	void unparse(std::ostream& out, int indent);
+	const Position * pos() const { return &myPos; }
+	std::string posStr() const { return pos()->span(); }
 protected:
-	const Position * myPos = nullptr;
+	/* Held in the node itself, so that making a node is one
+	   allocation and reading its span touches no other memory */
+	Position myPos;
+private:
+	NodeKind myKind;
 };
 
-/** 
+/**
 * \class ProgramNode
 * Class that contains the entire abstract syntax tree for a program.
 * Note the list of declarations encompasses all global declarations
@@ -43,10 +101,10 @@ protected:
 **/
 class ProgramNode : public ASTNode{
 public:
-	ProgramNode(std::list<DeclNode *> * globalsIn) ;
-	void unparse(std::ostream& out, int indent) override;
+	ProgramNode(NodeList<DeclNode *> * globalsIn) ;
+	const NodeList<DeclNode *> * globals() const { return myGlobals; }
 private:
-	std::list<DeclNode * > * myGlobals;
+	NodeList<DeclNode * > * myGlobals;
 };
 
 /**  \class ExpNode
@@ -56,48 +114,38 @@ private:
 **/
 class ExpNode : public ASTNode{
 protected:
-    ExpNode(const Position * p) : ASTNode(p){ }
-public:
-    virtual void unparse(std::ostream& out, int indent) = 0;
-    virtual void nestedUnparse(std::ostream& out, int indent);
+    ExpNode(NodeKind kind, const Position& p) : ASTNode(kind, p){ }
 };
 
 class CallExpNode : public ExpNode {
 public:
-    CallExpNode(const Position * p, LocNode * nameIn, std::list<ExpNode *> * argsIn) : ExpNode(p), functionName(nameIn), args(argsIn) { }
-    void unparse(std::ostream& out, int indent) override;
-    void nestedUnparse(std::ostream& out, int indent) override;
+    CallExpNode(const Position& p, LocNode * nameIn, NodeList<ExpNode *> * argsIn) : ExpNode(NodeKind::CALL_EXP, p), functionName(nameIn), args(argsIn) { }
+    LocNode * getFunctionName() const { return functionName; }
+    const NodeList<ExpNode *> * getArgs() const { return args; }
 private:
     LocNode * functionName;
-    std::list<ExpNode *> * args;
+    NodeList<ExpNode *> * args;
 };
 
 class FalseNode : public ExpNode {
 public:
-    FalseNode(const Position * p) : ExpNode(p) { }
-    void unparse(std::ostream& out, int indent) override;
-    void nestedUnparse(std::ostream& out, int indent) override;
+    FalseNode(const Position& p) : ExpNode(NodeKind::FALSE_LIT, p) { }
 };
 
 class TrueNode : public ExpNode {
 public:
-    TrueNode(const Position * p) : ExpNode(p) { }
-    void unparse(std::ostream& out, int indent) override;
-    void nestedUnparse(std::ostream& out, int indent) override;
+    TrueNode(const Position& p) : ExpNode(NodeKind::TRUE_LIT, p) { }
 };
 
 class MagicNode : public ExpNode {
 public:
-    MagicNode(const Position * p) : ExpNode(p) { }
-    void unparse(std::ostream& out, int indent) override;
-    void nestedUnparse(std::ostream& out, int indent) override;
+    MagicNode(const Position& p) : ExpNode(NodeKind::MAGIC, p) { }
 };
 
 class IntLitNode : public ExpNode {
 public:
-    IntLitNode(const Position * p, int valueIn) : ExpNode(p), value(valueIn) { }
-    void unparse(std::ostream& out, int indent) override;
-    void nestedUnparse(std::ostream& out, int indent) override;
+    IntLitNode(const Position& p, int valueIn) : ExpNode(NodeKind::INT_LIT, p), value(valueIn) { }
+    int getValue() const { return value; }
 
 private:
     int value;
@@ -105,20 +153,19 @@ private:
 
 class StrLitNode: public ExpNode {
 public:
-    StrLitNode(const Position * p, std::string strIn) : ExpNode(p), str(strIn) { }
-    void unparse(std::ostream& out, int indent) override;
-    void nestedUnparse(std::ostream& out, int indent) override;
+    StrLitNode(const Position& p, StrHandle strIn) : ExpNode(NodeKind::STR_LIT, p), str(strIn) { }
+    StrHandle getStr() const { return str; }
 private:
-    std::string str;
+    /** Interned text of the literal, quotes included **/
+    StrHandle str;
 };
 
 /** A memory location. LocNodes subclass ExpNode
  * because they can be used as part of an expression.
 **/
 class LocNode : public ExpNode{
-public:
-    LocNode(const Position * p) : ExpNode(p) {}
-    virtual void unparse(std::ostream& out, int indent) override = 0;
+protected:
+    LocNode(NodeKind kind, const Position& p) : ExpNode(kind, p) {}
 };
 
 /** An identifier. Note that IDNodes subclass
@@ -126,18 +173,18 @@ public:
 **/
 class IDNode : public LocNode{
 public:
-    IDNode(const Position * p, std::string functionIn) : LocNode(p), name(functionIn){ }
-    void unparse(std::ostream& out, int indent) override;
-    void nestedUnparse(std::ostream& out, int indent) override;
+    IDNode(const Position& p, StrHandle nameIn) : LocNode(NodeKind::ID, p), name(nameIn){ }
+    StrHandle getName() const { return name; }
 private:
-    /** The name of the identifier **/
-    std::string name;
+    /** The interned name of the identifier **/
+    StrHandle name;
 };
 
 class MemberFieldExpNode : public LocNode {
 public:
-    MemberFieldExpNode(const Position * p, LocNode * locIn, IDNode * nameIn) : LocNode(p), loc(locIn), name(nameIn) { }
-    void unparse(std::ostream& out, int indent) override;
+    MemberFieldExpNode(const Position& p, LocNode * locIn, IDNode * nameIn) : LocNode(NodeKind::MEMBER_FIELD, p), loc(locIn), name(nameIn) { }
+    LocNode * getLoc() const { return loc; }
+    IDNode * getName() const { return name; }
 private:
     LocNode * loc;
     IDNode * name;
@@ -145,118 +192,104 @@ private:
 
 class UnaryExpNode : public ExpNode {
 public:
-    UnaryExpNode(const Position * p, ExpNode * expIn) : ExpNode(p), exp(expIn) { }
-    virtual void unparse(std::ostream& out, int indent) = 0;
+    ExpNode * getExp() const { return exp; }
 
 protected:
+    UnaryExpNode(NodeKind kind, const Position& p, ExpNode * expIn) : ExpNode(kind, p), exp(expIn) { }
     ExpNode * exp;
 };
 
 class NegNode : public UnaryExpNode {
 public:
-    NegNode(const Position * p, ExpNode * exp) : UnaryExpNode(p, exp) { }
-    void unparse(std::ostream& out, int indent) override;
+    NegNode(const Position& p, ExpNode * exp) : UnaryExpNode(NodeKind::NEG, p, exp) { }
 };
 
 class NotNode : public UnaryExpNode {
 public:
-    NotNode(const Position * p, ExpNode * exp) : UnaryExpNode(p, exp) { }
-    void unparse(std::ostream& out, int indent) override;
+    NotNode(const Position& p, ExpNode * exp) : UnaryExpNode(NodeKind::NOT, p, exp) { }
 };
 
 class BinaryExpNode : public ExpNode {
 public:
-    BinaryExpNode(const Position * p, ExpNode * lhsIn, ExpNode * rhsIn) : ExpNode(p), lhs(lhsIn), rhs(rhsIn) { }
-    virtual void unparse(std::ostream& out, int indent) = 0;
+    ExpNode * getLhs() const { return lhs; }
+    ExpNode * getRhs() const { return rhs; }
 
 protected:
+    BinaryExpNode(NodeKind kind, const Position& p, ExpNode * lhsIn, ExpNode * rhsIn) : ExpNode(kind, p), lhs(lhsIn), rhs(rhsIn) { }
     ExpNode * lhs;
     ExpNode * rhs;
 };
 
 class AndNode : public BinaryExpNode {
 public:
-    AndNode(const Position * p, ExpNode * lhs, ExpNode * rhs) : BinaryExpNode(p,lhs,rhs) { }
-    void unparse(std::ostream& out, int indent) override;
+    AndNode(const Position& p, ExpNode * lhs, ExpNode * rhs) : BinaryExpNode(NodeKind::AND, p,lhs,rhs) { }
 };
 
 class DivideNode : public BinaryExpNode {
 public:
-    DivideNode(const Position * p, ExpNode * lhs, ExpNode * rhs) : BinaryExpNode(p,lhs,rhs) { }
-    void unparse(std::ostream& out, int indent) override;
+    DivideNode(const Position& p, ExpNode * lhs, ExpNode * rhs) : BinaryExpNode(NodeKind::DIVIDE, p,lhs,rhs) { }
 };
 
 class EqualsNode : public BinaryExpNode {
 public:
-    EqualsNode(const Position * p, ExpNode * lhs, ExpNode * rhs) : BinaryExpNode(p,lhs,rhs) { }
-    void unparse(std::ostream& out, int indent) override;
+    EqualsNode(const Position& p, ExpNode * lhs, ExpNode * rhs) : BinaryExpNode(NodeKind::EQUALS, p,lhs,rhs) { }
 };
 
 class GreaterEqNode : public BinaryExpNode {
 public:
-    GreaterEqNode(const Position * p, ExpNode * lhs, ExpNode * rhs) : BinaryExpNode(p,lhs,rhs) { }
-    void unparse(std::ostream& out, int indent) override;
+    GreaterEqNode(const Position& p, ExpNode * lhs, ExpNode * rhs) : BinaryExpNode(NodeKind::GREATER_EQ, p,lhs,rhs) { }
 };
 
 class GreaterNode : public BinaryExpNode {
 public:
-    GreaterNode(const Position * p, ExpNode * lhs, ExpNode * rhs) : BinaryExpNode(p,lhs,rhs) { }
-    void unparse(std::ostream& out, int indent) override;
+    GreaterNode(const Position& p, ExpNode * lhs, ExpNode * rhs) : BinaryExpNode(NodeKind::GREATER, p,lhs,rhs) { }
 };
 
 class LessNode : public BinaryExpNode {
 public:
-    LessNode(const Position * p, ExpNode * lhs, ExpNode * rhs) : BinaryExpNode(p,lhs,rhs) { }
-    void unparse(std::ostream& out, int indent) override;
+    LessNode(const Position& p, ExpNode * lhs, ExpNode * rhs) : BinaryExpNode(NodeKind::LESS, p,lhs,rhs) { }
 };
 
 class LessEqNode : public BinaryExpNode {
 public:
-    LessEqNode(const Position * p, ExpNode * lhs, ExpNode * rhs) : BinaryExpNode(p,lhs,rhs) { }
-    void unparse(std::ostream& out, int indent) override;
+    LessEqNode(const Position& p, ExpNode * lhs, ExpNode * rhs) : BinaryExpNode(NodeKind::LESS_EQ, p,lhs,rhs) { }
 };
 
 class MinusNode : public BinaryExpNode {
 public:
-    MinusNode(const Position * p, ExpNode * lhs, ExpNode * rhs) : BinaryExpNode(p,lhs,rhs) { }
-    void unparse(std::ostream& out, int indent) override;
+    MinusNode(const Position& p, ExpNode * lhs, ExpNode * rhs) : BinaryExpNode(NodeKind::MINUS, p,lhs,rhs) { }
 };
 
 class NotEqualsNode : public BinaryExpNode {
 public:
-    NotEqualsNode(const Position * p, ExpNode * lhs, ExpNode * rhs) : BinaryExpNode(p,lhs,rhs) { }
-    void unparse(std::ostream& out, int indent) override;
+    NotEqualsNode(const Position& p, ExpNode * lhs, ExpNode * rhs) : BinaryExpNode(NodeKind::NOT_EQUALS, p,lhs,rhs) { }
 };
 
 class OrNode : public BinaryExpNode {
 public:
-    OrNode(const Position * p, ExpNode * lhs, ExpNode * rhs) : BinaryExpNode(p,lhs,rhs) { }
-    void unparse(std::ostream& out, int indent) override;
+    OrNode(const Position& p, ExpNode * lhs, ExpNode * rhs) : BinaryExpNode(NodeKind::OR, p,lhs,rhs) { }
 };
 
 class PlusNode : public BinaryExpNode {
 public:
-    PlusNode(const Position * p, ExpNode * lhs, ExpNode * rhs) : BinaryExpNode(p,lhs,rhs) { }
-    void unparse(std::ostream& out, int indent) override;
+    PlusNode(const Position& p, ExpNode * lhs, ExpNode * rhs) : BinaryExpNode(NodeKind::PLUS, p,lhs,rhs) { }
 };
 
 class TimesNode : public BinaryExpNode {
 public:
-    TimesNode(const Position * p, ExpNode * lhs, ExpNode * rhs) : BinaryExpNode(p,lhs,rhs) { }
-    void unparse(std::ostream& out, int indent) override;
+    TimesNode(const Position& p, ExpNode * lhs, ExpNode * rhs) : BinaryExpNode(NodeKind::TIMES, p,lhs,rhs) { }
 };
 
 class StmtNode : public ASTNode{
-public:
-	StmtNode(const Position * p) : ASTNode(p){ }
-	void unparse(std::ostream& out, int indent) override = 0;
-    void nestedUnparse(std::ostream& out, int indent);
+protected:
+	StmtNode(NodeKind kind, const Position& p) : ASTNode(kind, p){ }
 };
 
 class AssignStmtNode : public StmtNode {
 public:
-    AssignStmtNode(const Position * p, LocNode * destIn, ExpNode * expIn) : StmtNode(p), dest(destIn), exp(expIn) { }
-    void unparse(std::ostream& out, int indent) override;
+    AssignStmtNode(const Position& p, LocNode * destIn, ExpNode * expIn) : StmtNode(NodeKind::ASSIGN, p), dest(destIn), exp(expIn) { }
+    LocNode * getDest() const { return dest; }
+    ExpNode * getExp() const { return exp; }
 private:
     LocNode * dest;
     ExpNode * exp;
@@ -264,105 +297,109 @@ private:
 
 class CallStmtNode : public StmtNode {
 public:
-    CallStmtNode(const Position * p, CallExpNode * callIn) : StmtNode(p), call(callIn) { }
-    void unparse(std::ostream& out, int indent) override;
+    CallStmtNode(const Position& p, CallExpNode * callIn) : StmtNode(NodeKind::CALL_STMT, p), call(callIn) { }
+    CallExpNode * getCall() const { return call; }
 private:
     CallExpNode * call;
 };
 
 class ExitStmtNode : public StmtNode {
 public:
-    ExitStmtNode(const Position * p) : StmtNode(p) { }
-    void unparse(std::ostream& out, int indent) override;
+    ExitStmtNode(const Position& p) : StmtNode(NodeKind::EXIT, p) { }
 };
 
 class GiveStmtNode : public StmtNode {
 public:
-    GiveStmtNode(const Position * p, ExpNode * expIn) : StmtNode(p), exp(expIn) { }
-    void unparse(std::ostream& out, int indent) override;
+    GiveStmtNode(const Position& p, ExpNode * expIn) : StmtNode(NodeKind::GIVE, p), exp(expIn) { }
+    ExpNode * getExp() const { return exp; }
 private:
     ExpNode * exp;
 };
 
 class IfElseStmtNode : public StmtNode {
 public:
-    IfElseStmtNode(const Position * p, ExpNode * conIn, std::list<StmtNode *> * trueIn, std::list<StmtNode *> * falseIn)
-    : StmtNode(p), condition(conIn), trueBranch(trueIn), falseBranch(falseIn) { }
-    void unparse(std::ostream& out, int indent) override;
+    IfElseStmtNode(const Position& p, ExpNode * conIn, NodeList<StmtNode *> * trueIn, NodeList<StmtNode *> * falseIn)
+    : StmtNode(NodeKind::IF_ELSE, p), condition(conIn), trueBranch(trueIn), falseBranch(falseIn) { }
+    ExpNode * getCondition() const { return condition; }
+    const NodeList<StmtNode *> * getTrueBranch() const { return trueBranch; }
+    const NodeList<StmtNode *> * getFalseBranch() const { return falseBranch; }
 private:
     ExpNode * condition;
-    std::list<StmtNode *> * trueBranch;
-    std::list<StmtNode *> * falseBranch;
+    NodeList<StmtNode *> * trueBranch;
+    NodeList<StmtNode *> * falseBranch;
 };
 
 class IfStmtNode : public StmtNode {
 public:
-    IfStmtNode(const Position * p, ExpNode * conIn, std::list<StmtNode *> * stmtsIn)
-    : StmtNode(p), condition(conIn), stmts(stmtsIn) { }
-    void unparse(std::ostream& out, int indent) override;
+    IfStmtNode(const Position& p, ExpNode * conIn, NodeList<StmtNode *> * stmtsIn)
+    : StmtNode(NodeKind::IF, p), condition(conIn), stmts(stmtsIn) { }
+    ExpNode * getCondition() const { return condition; }
+    const NodeList<StmtNode *> * getStmts() const { return stmts; }
 private:
     ExpNode * condition;
-    std::list<StmtNode *> * stmts;
+    NodeList<StmtNode *> * stmts;
 };
 
 class PostDecStmtNode : public StmtNode {
 public:
-    PostDecStmtNode(const Position * p, LocNode * locIn) : StmtNode(p), loc(locIn) { }
-    void unparse(std::ostream& out, int indent) override;
+    PostDecStmtNode(const Position& p, LocNode * locIn) : StmtNode(NodeKind::POST_DEC, p), loc(locIn) { }
+    LocNode * getLoc() const { return loc; }
 private:
     LocNode * loc;
 };
 
 class PostIncStmtNode : public StmtNode {
 public:
-    PostIncStmtNode(const Position * p, LocNode * locIn) : StmtNode(p), loc(locIn) { }
-    void unparse(std::ostream& out, int indent) override;
+    PostIncStmtNode(const Position& p, LocNode * locIn) : StmtNode(NodeKind::POST_INC, p), loc(locIn) { }
+    LocNode * getLoc() const { return loc; }
 private:
     LocNode * loc;
 };
 
 class ReturnStmtNode : public StmtNode {
 public:
-    ReturnStmtNode(const Position * p, ExpNode * expIn) : StmtNode(p), exp(expIn) { }
-    void unparse(std::ostream& out, int indent) override;
+    ReturnStmtNode(const Position& p, ExpNode * expIn) : StmtNode(NodeKind::RETURN, p), exp(expIn) { }
+    /** The returned value, or nullptr for a bare return **/
+    ExpNode * getExp() const { return exp; }
 private:
     ExpNode * exp;
 };
 
 class TakeStmtNode : public StmtNode {
 public:
-    TakeStmtNode(const Position * p, LocNode * locIn) : StmtNode(p), loc(locIn) { }
-    void unparse(std::ostream& out, int indent) override;
+    TakeStmtNode(const Position& p, LocNode * locIn) : StmtNode(NodeKind::TAKE, p), loc(locIn) { }
+    LocNode * getLoc() const { return loc; }
 private:
     LocNode * loc;
 };
 
 class WhileStmtNode : public StmtNode {
 public:
-    WhileStmtNode(const Position * p, ExpNode * expIn, std::list<StmtNode *> * stmtsIn) : StmtNode(p), exp(expIn), stmts(stmtsIn) { }
-    void unparse(std::ostream& out, int indent) override;
+    WhileStmtNode(const Position& p, ExpNode * expIn, NodeList<StmtNode *> * stmtsIn) : StmtNode(NodeKind::WHILE, p), exp(expIn), stmts(stmtsIn) { }
+    ExpNode * getExp() const { return exp; }
+    const NodeList<StmtNode *> * getStmts() const { return stmts; }
 private:
     ExpNode * exp;
-    std::list <StmtNode *> * stmts;
+    NodeList<StmtNode *> * stmts;
 };
 
 /** \class DeclNode
-* Superclass for declarations (i.e. nodes that can be used to 
-* declare a struct, function, variable, etc).  This base class will 
+* Superclass for declarations (i.e. nodes that can be used to
+* declare a struct, function, variable, etc).  This base class will
 **/
 class DeclNode : public StmtNode{
-public:
-	DeclNode(const Position * p) : StmtNode(p) { }
-	virtual void unparse(std::ostream& out, int indent) override = 0;
+protected:
+	DeclNode(NodeKind kind, const Position& p) : StmtNode(kind, p) { }
 };
 
 class ClassDeclNode : public DeclNode {
 public:
-    ClassDeclNode(const Position * p, IDNode * nameIn, std::list<DeclNode *> * declsIn) : DeclNode(p), name(nameIn), decls(declsIn) { }
-    void unparse(std::ostream& out, int indent) override;
+    ClassDeclNode(const Position& p, IDNode * nameIn, NodeList<DeclNode *> * declsIn) : DeclNode(NodeKind::CLASS_DECL, p), name(nameIn), decls(declsIn) { }
+    IDNode * getName() const { return name; }
+    const NodeList<DeclNode *> * getDecls() const { return decls; }
 private:
     IDNode * name;
-    std::list<DeclNode *> * decls;
+    NodeList<DeclNode *> * decls;
 };
 
 /** A variable declaration.
@@ -370,14 +407,19 @@ private:
 
 class VarDeclNode : public DeclNode{
 public:
-    VarDeclNode(const Position * p, IDNode * inID, TypeNode * inType, ExpNode * expIn = nullptr)
-    : DeclNode(p), myID(inID), myType(inType), myExp(expIn){
+    VarDeclNode(const Position& p, IDNode * inID, TypeNode * inType, ExpNode * expIn = nullptr)
+    : VarDeclNode(NodeKind::VAR_DECL, p, inID, inType, expIn){ }
+    IDNode * getID() const { return myID; }
+    TypeNode * getType() const { return myType; }
+    /** The initializer, or nullptr if there isn't one **/
+    ExpNode * getExp() const { return myExp; }
+
+protected:
+    VarDeclNode(NodeKind kind, const Position& p, IDNode * inID, TypeNode * inType, ExpNode * expIn)
+    : DeclNode(kind, p), myID(inID), myType(inType), myExp(expIn){
         assert (myType != nullptr);
         assert (myID != nullptr);
     }
-    void unparse(std::ostream& out, int indent);
-
-protected:
     IDNode * myID;
     TypeNode * myType;
     ExpNode * myExp;
@@ -385,20 +427,22 @@ protected:
 
 class FormalDeclNode : public VarDeclNode {
 public:
-    FormalDeclNode(const Position * p, IDNode * id, TypeNode * type) : VarDeclNode(p,id,type) {}
-    void unparse(std::ostream& out, int indent) override;
+    FormalDeclNode(const Position& p, IDNode * id, TypeNode * type) : VarDeclNode(NodeKind::FORMAL_DECL, p,id,type,nullptr) {}
 };
 
 class FnDeclNode : public DeclNode {
 public:
-    FnDeclNode(const Position * p, TypeNode * typeIn, IDNode * idIn, std::list<FormalDeclNode *> * declsIn, std::list<StmtNode *> * stmtsIn)
-    : DeclNode(p), type(typeIn), id(idIn), decls(declsIn), stmts(stmtsIn) { }
-    void unparse(std::ostream& out, int indent);
+    FnDeclNode(const Position& p, TypeNode * typeIn, IDNode * idIn, NodeList<FormalDeclNode *> * declsIn, NodeList<StmtNode *> * stmtsIn)
+    : DeclNode(NodeKind::FN_DECL, p), type(typeIn), id(idIn), decls(declsIn), stmts(stmtsIn) { }
+    TypeNode * getType() const { return type; }
+    IDNode * getID() const { return id; }
+    const NodeList<FormalDeclNode *> * getDecls() const { return decls; }
+    const NodeList<StmtNode *> * getStmts() const { return stmts; }
 private:
     TypeNode * type;
     IDNode * id;
-    std::list <FormalDeclNode *> * decls;
-    std::list <StmtNode *> * stmts;
+    NodeList<FormalDeclNode *> * decls;
+    NodeList<StmtNode *> * stmts;
 };
 
 /**  \class TypeNode
@@ -408,44 +452,39 @@ private:
 **/
 class TypeNode : public ASTNode{
 protected:
-	TypeNode(const Position * p) : ASTNode(p){
+	TypeNode(NodeKind kind, const Position& p) : ASTNode(kind, p){
 	}
-public:
-	virtual void unparse(std::ostream& out, int indent) = 0;
 };
 
 class IntTypeNode : public TypeNode{
 public:
-	IntTypeNode(const Position * p) : TypeNode(p){ }
-	void unparse(std::ostream& out, int indent);
+	IntTypeNode(const Position& p) : TypeNode(NodeKind::INT_TYPE, p){ }
 };
 
 class BoolTypeNode : public TypeNode{
 public:
-    BoolTypeNode(const Position * p) : TypeNode(p){ }
-    void unparse(std::ostream& out, int indent);
+    BoolTypeNode(const Position& p) : TypeNode(NodeKind::BOOL_TYPE, p){ }
 };
 
 class ClassTypeNode : public TypeNode{
 public:
-    ClassTypeNode(const Position * p, IDNode * idIn) : TypeNode(p), id(idIn) { }
-    void unparse(std::ostream& out, int indent);
+    ClassTypeNode(const Position& p, IDNode * idIn) : TypeNode(NodeKind::CLASS_TYPE, p), id(idIn) { }
+    IDNode * getID() const { return id; }
 private:
     IDNode * id;
 };
 
 class PerfectTypeNode : public TypeNode{
 public:
-    PerfectTypeNode(const Position * p, TypeNode * typeIn) : TypeNode(p), type(typeIn) { }
-    void unparse(std::ostream& out, int indent);
+    PerfectTypeNode(const Position& p, TypeNode * typeIn) : TypeNode(NodeKind::PERFECT_TYPE, p), type(typeIn) { }
+    TypeNode * getType() const { return type; }
 private:
     TypeNode * type;
 };
 
 class VoidTypeNode : public TypeNode{
 public:
-    VoidTypeNode(const Position * p) : TypeNode(p){ }
-    void unparse(std::ostream& out, int indent);
+    VoidTypeNode(const Position& p) : TypeNode(NodeKind::VOID_TYPE, p){ }
 };
 
 } //End namespace drewno_mars
@@ -0,0 +1,264 @@
+#include "astbuilder.hpp"
+#include "errors.hpp"
+
+namespace drewno_mars{
+
+static NodeRef ref(ASTNode * node){
+	NodeRef result;
+	result.node = node;
+	return result;
+}
+
+template <typename T>
+static T * as(NodeRef ref){
+	return static_cast<T *>(ref.node);
+}
+
+template <typename T>
+NodeList<T *> * PointerBuilder::closeList(ListRef list){
+	NodeList<T *> * result = myArena.make<NodeList<T *>>(myArena);
+	result->reserve(myPending.size() - list);
+	for (size_t i = list; i < myPending.size(); i++){
+		result->push_back(static_cast<T *>(myPending[i]));
+	}
+	myPending.resize(list);
+	return result;
+}
+
+NodeRef PointerBuilder::leaf(NodeKind kind, const Position& pos,
+  uint32_t value){
+	switch (kind){
+	case NodeKind::INT_TYPE: return ref(myArena.make<IntTypeNode>(pos));
+	case NodeKind::BOOL_TYPE: return ref(myArena.make<BoolTypeNode>(pos));
+	case NodeKind::VOID_TYPE: return ref(myArena.make<VoidTypeNode>(pos));
+	case NodeKind::EXIT: return ref(myArena.make<ExitStmtNode>(pos));
+	case NodeKind::RETURN:
+		return ref(myArena.make<ReturnStmtNode>(pos, nullptr));
+	case NodeKind::FALSE_LIT: return ref(myArena.make<FalseNode>(pos));
+	case NodeKind::TRUE_LIT: return ref(myArena.make<TrueNode>(pos));
+	case NodeKind::MAGIC: return ref(myArena.make<MagicNode>(pos));
+	case NodeKind::INT_LIT:
+		return ref(myArena.make<IntLitNode>(pos, static_cast<int>(value)));
+	case NodeKind::STR_LIT:
+		return ref(myArena.make<StrLitNode>(pos, value));
+	case NodeKind::ID:
+		return ref(myArena.make<IDNode>(pos, value));
+	default:
+		throw new InternalError("Not a leaf node kind");
+	}
+}
+
+NodeRef PointerBuilder::unary(NodeKind kind, const Position& pos,
+  NodeRef child){
+	ASTNode * node;
+	switch (kind){
+	case NodeKind::CLASS_TYPE:
+		node = myArena.make<ClassTypeNode>(pos, as<IDNode>(child));
+		break;
+	case NodeKind::PERFECT_TYPE:
+		node = myArena.make<PerfectTypeNode>(pos, as<TypeNode>(child));
+		break;
+	case NodeKind::CALL_STMT:
+		node = myArena.make<CallStmtNode>(pos, as<CallExpNode>(child));
+		break;
+	case NodeKind::GIVE:
+		node = myArena.make<GiveStmtNode>(pos, as<ExpNode>(child));
+		break;
+	case NodeKind::RETURN:
+		node = myArena.make<ReturnStmtNode>(pos, as<ExpNode>(child));
+		break;
+	case NodeKind::POST_DEC:
+		node = myArena.make<PostDecStmtNode>(pos, as<LocNode>(child));
+		break;
+	case NodeKind::POST_INC:
+		node = myArena.make<PostIncStmtNode>(pos, as<LocNode>(child));
+		break;
+	case NodeKind::TAKE:
+		node = myArena.make<TakeStmtNode>(pos, as<LocNode>(child));
+		break;
+	case NodeKind::NEG:
+		node = myArena.make<NegNode>(pos, as<ExpNode>(child));
+		break;
+	case NodeKind::NOT:
+		node = myArena.make<NotNode>(pos, as<ExpNode>(child));
+		break;
+	default:
+		throw new InternalError("Not a unary node kind");
+	}
+	return ref(node);
+}
+
+/* The binary operators, which differ only in their class */
+template <typename T>
+static ASTNode * makeBinary(Arena& arena, const Position& p,
+  NodeRef lhs, NodeRef rhs){
+	return arena.make<T>(p, as<ExpNode>(lhs), as<ExpNode>(rhs));
+}
+
+NodeRef PointerBuilder::binary(NodeKind kind, const Position& pos,
+  NodeRef lhs, NodeRef rhs){
+	ASTNode * node;
+	switch (kind){
+	case NodeKind::FORMAL_DECL:
+		node = myArena.make<FormalDeclNode>(pos, as<IDNode>(lhs),
+		  as<TypeNode>(rhs));
+		break;
+	case NodeKind::ASSIGN:
+		node = myArena.make<AssignStmtNode>(pos, as<LocNode>(lhs),
+		  as<ExpNode>(rhs));
+		break;
+	case NodeKind::MEMBER_FIELD:
+		node = myArena.make<MemberFieldExpNode>(pos, as<LocNode>(lhs),
+		  as<IDNode>(rhs));
+		break;
+	case NodeKind::AND:
+		node = makeBinary<AndNode>(myArena, pos, lhs, rhs);
+		break;
+	case NodeKind::DIVIDE:
+		node = makeBinary<DivideNode>(myArena, pos, lhs, rhs);
+		break;
+	case NodeKind::EQUALS:
+		node = makeBinary<EqualsNode>(myArena, pos, lhs, rhs);
+		break;
+	case NodeKind::GREATER_EQ:
+		node = makeBinary<GreaterEqNode>(myArena, pos, lhs, rhs);
+		break;
+	case NodeKind::GREATER:
+		node = makeBinary<GreaterNode>(myArena, pos, lhs, rhs);
+		break;
+	case NodeKind::LESS:
+		node = makeBinary<LessNode>(myArena, pos, lhs, rhs);
+		break;
+	case NodeKind::LESS_EQ:
+		node = makeBinary<LessEqNode>(myArena, pos, lhs, rhs);
+		break;
+	case NodeKind::MINUS:
+		node = makeBinary<MinusNode>(myArena, pos, lhs, rhs);
+		break;
+	case NodeKind::NOT_EQUALS:
+		node = makeBinary<NotEqualsNode>(myArena, pos, lhs, rhs);
+		break;
+	case NodeKind::OR:
+		node = makeBinary<OrNode>(myArena, pos, lhs, rhs);
+		break;
+	case NodeKind::PLUS:
+		node = makeBinary<PlusNode>(myArena, pos, lhs, rhs);
+		break;
+	case NodeKind::TIMES:
+		node = makeBinary<TimesNode>(myArena, pos, lhs, rhs);
+		break;
+	default:
+		throw new InternalError("Not a binary node kind");
+	}
+	return ref(node);
+}
+
+NodeRef PointerBuilder::listed(NodeKind kind, const Position& pos,
+  NodeRef head, ListRef list){
+	ASTNode * node;
+	switch (kind){
+	case NodeKind::CLASS_DECL:
+		node = myArena.make<ClassDeclNode>(pos, as<IDNode>(head),
+		  closeList<DeclNode>(list));
+		break;
+	case NodeKind::IF:
+		node = myArena.make<IfStmtNode>(pos, as<ExpNode>(head),
+		  closeList<StmtNode>(list));
+		break;
+	case NodeKind::WHILE:
+		node = myArena.make<WhileStmtNode>(pos, as<ExpNode>(head),
+		  closeList<StmtNode>(list));
+		break;
+	case NodeKind::CALL_EXP:
+		node = myArena.make<CallExpNode>(pos, as<LocNode>(head),
+		  closeList<ExpNode>(list));
+		break;
+	default:
+		throw new InternalError("Not a node kind with a list");
+	}
+	return ref(node);
+}
+
+NodeRef PointerBuilder::varDecl(const Position& pos, NodeRef id,
+  NodeRef type, const NodeRef * init){
+	ExpNode * exp = init == nullptr ? nullptr : as<ExpNode>(*init);
+	return ref(myArena.make<VarDeclNode>(pos, as<IDNode>(id),
+	  as<TypeNode>(type), exp));
+}
+
+NodeRef PointerBuilder::fnDecl(const Position& pos, NodeRef id,
+  ListRef formals, NodeRef type, ListRef body){
+	// The body was opened last, so it is closed first
+	NodeList<StmtNode *> * stmts = closeList<StmtNode>(body);
+	NodeList<FormalDeclNode *> * decls = closeList<FormalDeclNode>(formals);
+	return ref(myArena.make<FnDeclNode>(pos, as<TypeNode>(type),
+	  as<IDNode>(id), decls, stmts));
+}
+
+NodeRef PointerBuilder::ifElse(const Position& pos, NodeRef cond,
+  ListRef yes, ListRef no){
+	NodeList<StmtNode *> * noStmts = closeList<StmtNode>(no);
+	NodeList<StmtNode *> * yesStmts = closeList<StmtNode>(yes);
+	return ref(myArena.make<IfElseStmtNode>(pos, as<ExpNode>(cond),
+	  yesStmts, noStmts));
+}
+
+void PointerBuilder::program(ListRef globals){
+	myRoot = myArena.make<ProgramNode>(closeList<DeclNode>(globals));
+}
+
+NodeRef FlatBuilder::leaf(NodeKind kind, const Position& pos,
+  uint32_t value){
+	return ref(myTree.add(kind, pos, value));
+}
+
+NodeRef FlatBuilder::unary(NodeKind kind, const Position& pos,
+  NodeRef child){
+	return ref(myTree.add(kind, pos, child.index));
+}
+
+NodeRef FlatBuilder::binary(NodeKind kind, const Position& pos,
+  NodeRef lhs, NodeRef rhs){
+	return ref(myTree.add(kind, pos, lhs.index, rhs.index));
+}
+
+NodeRef FlatBuilder::listed(NodeKind kind, const Position& pos,
+  NodeRef head, ListRef list){
+	return ref(myTree.add(kind, pos, head.index, myTree.closeList(list)));
+}
+
+NodeRef FlatBuilder::varDecl(const Position& pos, NodeRef id,
+  NodeRef type, const NodeRef * init){
+	NodeIndex exp = init == nullptr ? 0 : init->index;
+	return ref(myTree.add(NodeKind::VAR_DECL, pos, id.index,
+	  myTree.addExtra(type.index, exp)));
+}
+
+NodeRef FlatBuilder::fnDecl(const Position& pos, NodeRef id,
+  ListRef formals, NodeRef type, ListRef body){
+	ListIndex stmts = myTree.closeList(body);
+	ListIndex decls = myTree.closeList(formals);
+	return ref(myTree.add(NodeKind::FN_DECL, pos, id.index,
+	  myTree.addExtra(type.index, decls, stmts)));
+}
+
+NodeRef FlatBuilder::ifElse(const Position& pos, NodeRef cond,
+  ListRef yes, ListRef no){
+	ListIndex noStmts = myTree.closeList(no);
+	ListIndex yesStmts = myTree.closeList(yes);
+	return ref(myTree.add(NodeKind::IF_ELSE, pos, cond.index,
+	  myTree.addExtra(yesStmts, noStmts)));
+}
+
+void FlatBuilder::program(ListRef globals){
+	ListIndex list = myTree.closeList(globals);
+	// Spans the globals, as a ProgramNode does
+	Position span(0,0,0,0);
+	if (myTree.listBegin(list) != myTree.listEnd(list)){
+		span = Position(&myTree.span(*myTree.listBegin(list)),
+		  &myTree.span(*(myTree.listEnd(list) - 1)));
+	}
+	myTree.setRoot(myTree.add(NodeKind::PROGRAM, span, list));
+}
+
+}
@@ -0,0 +1,160 @@
+#ifndef DREWNO_MARS_ASTBUILDER_H
+#define DREWNO_MARS_ASTBUILDER_H
+
+#include <vector>
+#include "arena.hpp"
+#include "ast.hpp"
+#include "flatast.hpp"
+
+namespace drewno_mars{
+
+/* A node made by an ASTBuilder: a pointer from a PointerBuilder, an
+   index from a FlatBuilder. Only the builder that made it reads it. */
+union NodeRef{
+	ASTNode * node;
+	NodeIndex index;
+};
+
+/* A list being collected by an ASTBuilder, as returned by openList */
+using ListRef = uint32_t;
+
+/**
+* \class ASTBuilder
+* What the parser's actions build the tree through. Each node is made
+* once its children are, as the parser reduces; lists are opened,
+* pushed onto, and handed whole to the node that holds them. A list
+* must be handed over before any list opened after it that is still
+* open, which the grammar's nesting guarantees.
+**/
+class ASTBuilder{
+public:
+	virtual ~ASTBuilder(){ }
+
+	/** A node without children: a primitive type, exit, a constant,
+	    an ID or a return without a value. value is an ID's or
+	    string's handle, or an integer's bits. **/
+	virtual NodeRef leaf(NodeKind kind, const Position& pos,
+	  uint32_t value = 0) = 0;
+	/** A node with one child **/
+	virtual NodeRef unary(NodeKind kind, const Position& pos,
+	  NodeRef child) = 0;
+	/** A formal, an assignment, a member field or an operator **/
+	virtual NodeRef binary(NodeKind kind, const Position& pos,
+	  NodeRef lhs, NodeRef rhs) = 0;
+	/** A class, if, while or call: a child, then a list **/
+	virtual NodeRef listed(NodeKind kind, const Position& pos,
+	  NodeRef head, ListRef list) = 0;
+	/** init is null for a declaration without one **/
+	virtual NodeRef varDecl(const Position& pos, NodeRef id,
+	  NodeRef type, const NodeRef * init) = 0;
+	virtual NodeRef fnDecl(const Position& pos, NodeRef id,
+	  ListRef formals, NodeRef type, ListRef body) = 0;
+	virtual NodeRef ifElse(const Position& pos, NodeRef cond,
+	  ListRef yes, ListRef no) = 0;
+	/** The root, which ends the tree **/
+	virtual void program(ListRef globals) = 0;
+
+	virtual ListRef openList() = 0;
+	virtual void push(NodeRef item) = 0;
+	/** Forget a list the parser threw away while recovering from a
+	    syntax error, and whatever was pushed after it was opened **/
+	virtual void discard(ListRef list) = 0;
+
+	virtual const Position& span(NodeRef node) const = 0;
+	Position span(NodeRef from, NodeRef to) const {
+		return Position(&span(from), &span(to));
+	}
+};
+
+/**
+* \class PointerBuilder
+* Builds linked nodes in an arena, the tree the rest of the front end
+* works on.
+**/
+class PointerBuilder : public ASTBuilder{
+public:
+	explicit PointerBuilder(Arena& arena) : myArena(arena){ }
+
+	/** The tree, once program() has been called **/
+	ProgramNode * root() const { return myRoot; }
+
+	NodeRef leaf(NodeKind kind, const Position& pos,
+	  uint32_t value) override;
+	NodeRef unary(NodeKind kind, const Position& pos,
+	  NodeRef child) override;
+	NodeRef binary(NodeKind kind, const Position& pos,
+	  NodeRef lhs, NodeRef rhs) override;
+	NodeRef listed(NodeKind kind, const Position& pos,
+	  NodeRef head, ListRef list) override;
+	NodeRef varDecl(const Position& pos, NodeRef id,
+	  NodeRef type, const NodeRef * init) override;
+	NodeRef fnDecl(const Position& pos, NodeRef id,
+	  ListRef formals, NodeRef type, ListRef body) override;
+	NodeRef ifElse(const Position& pos, NodeRef cond,
+	  ListRef yes, ListRef no) override;
+	void program(ListRef globals) override;
+
+	ListRef openList() override {
+		return static_cast<ListRef>(myPending.size());
+	}
+	void push(NodeRef item) override { myPending.push_back(item.node); }
+	void discard(ListRef list) override {
+		if (list < myPending.size()){ myPending.resize(list); }
+	}
+
+	const Position& span(NodeRef node) const override {
+		return *node.node->pos();
+	}
+private:
+	template <typename T>
+	NodeList<T *> * closeList(ListRef list);
+
+	Arena& myArena;
+	std::vector<ASTNode *> myPending;
+	ProgramNode * myRoot = nullptr;
+};
+
+/**
+* \class FlatBuilder
+* Appends nodes to a FlatAST.
+**/
+class FlatBuilder : public ASTBuilder{
+public:
+	explicit FlatBuilder(FlatAST& tree) : myTree(tree){ }
+
+	NodeRef leaf(NodeKind kind, const Position& pos,
+	  uint32_t value) override;
+	NodeRef unary(NodeKind kind, const Position& pos,
+	  NodeRef child) override;
+	NodeRef binary(NodeKind kind, const Position& pos,
+	  NodeRef lhs, NodeRef rhs) override;
+	NodeRef listed(NodeKind kind, const Position& pos,
+	  NodeRef head, ListRef list) override;
+	NodeRef varDecl(const Position& pos, NodeRef id,
+	  NodeRef type, const NodeRef * init) override;
+	NodeRef fnDecl(const Position& pos, NodeRef id,
+	  ListRef formals, NodeRef type, ListRef body) override;
+	NodeRef ifElse(const Position& pos, NodeRef cond,
+	  ListRef yes, ListRef no) override;
+	void program(ListRef globals) override;
+
+	ListRef openList() override { return myTree.openList(); }
+	void push(NodeRef item) override { myTree.push(item.index); }
+	void discard(ListRef list) override { myTree.dropList(list); }
+
+	const Position& span(NodeRef node) const override {
+		return myTree.span(node.index);
+	}
+private:
+	NodeRef ref(NodeIndex index){
+		NodeRef result;
+		result.index = index;
+		return result;
+	}
+
+	FlatAST& myTree;
+};
+
+}
+
+#endif
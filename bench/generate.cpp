@@ -0,0 +1,261 @@
+/*
+Writes a synthetic, syntactically valid Drewno Mars program to
+stdout, for benchmarking the front end. The same shape, size and
+seed always give the same program.
+
+    generate <shape> <kilobytes> [seed]
+
+where shape is one of
+
+    globals      many global variables with initializers
+    nesting      functions of deeply nested while and if blocks
+    expressions  long chains of binary operators
+    classes      large classes of fields and methods
+    strings      many string literals
+    mixed        a blend of all of the above
+*/
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+
+namespace {
+
+class Generator{
+public:
+	Generator(unsigned seed) : myRandom(seed){ }
+
+	/** Emit declarations of the given shape until the program is
+	    at least limit bytes long **/
+	void run(const std::string& shape, size_t limit){
+		while (myOut.size() < limit){
+			if (shape == "globals"){ global(); }
+			else if (shape == "nesting"){ function(24); }
+			else if (shape == "expressions"){ chains(); }
+			else if (shape == "classes"){ classDecl(); }
+			else if (shape == "strings"){ strings(); }
+			else { // mixed
+				switch (below(5)){
+				case 0: global(); break;
+				case 1: function(6); break;
+				case 2: chains(); break;
+				case 3: classDecl(); break;
+				default: strings(); break;
+				}
+			}
+		}
+		std::cout << myOut;
+	}
+private:
+	/* mt19937's output is fixed by the standard (unlike the
+	   distributions), so every library gives the same program */
+	size_t below(size_t n){
+		return myRandom() % n;
+	}
+
+	std::string name(const char * prefix){
+		return prefix + std::to_string(myNames++);
+	}
+
+	void indent(int depth){ myOut.append(static_cast<size_t>(depth), '\t'); }
+
+	void global(){
+		myOut += name("g");
+		switch (below(3)){
+		case 0:
+			myOut += " : int = ";
+			myOut += std::to_string(below(100000));
+			break;
+		case 1:
+			myOut += " : bool = ";
+			myOut += below(2) ? "true" : "too hot";
+			break;
+		default:
+			myOut += " : perfect int = 24Kmagic";
+			break;
+		}
+		myOut += ";\n";
+	}
+
+	/* An expression with about size operators. Comparisons don't
+	   associate, so each one gets arithmetic on either side and
+	   they are joined with and/or. */
+	void exp(size_t size){
+		static const char * const logic[] = { " and ", " or " };
+		static const char * const compare[] = {
+			" == ", " != ", " < ", " <= ", " > ", " >= "
+		};
+		while (true){
+			size_t part = std::min(size, below(6));
+			size -= part;
+			arith(part / 2);
+			if (part > 1){
+				myOut += compare[below(6)];
+				arith(part - part / 2 - 1);
+			}
+			if (size == 0){ return; }
+			size--;
+			myOut += logic[below(2)];
+		}
+	}
+
+	void arith(size_t size){
+		static const char * const ops[] = { " + ", " - ", " * ", " / " };
+		operand();
+		for (size_t i = 0; i < size; i++){
+			myOut += ops[below(4)];
+			operand();
+		}
+	}
+
+	void operand(){
+		if (below(10) == 0){
+			myOut += "(";
+			exp(below(4));
+			myOut += ")";
+		} else {
+			term();
+		}
+	}
+
+	void term(){
+		switch (below(8)){
+		case 0: myOut += std::to_string(below(1000)); break;
+		case 1: myOut += "true"; break;
+		case 2: myOut += "-x"; break;
+		case 3: myOut += "!b"; break;
+		case 4: myOut += "o--f"; break;
+		case 5: myOut += "f(x, 1)"; break;
+		default: myOut += name("v"); break;
+		}
+	}
+
+	void stmt(int depth){
+		indent(depth);
+		switch (below(7)){
+		case 0:
+			myOut += "x = ";
+			exp(below(4) + 1);
+			break;
+		case 1: myOut += "x++"; break;
+		case 2: myOut += "o--f--"; break;
+		case 3:
+			myOut += "give ";
+			exp(below(2));
+			break;
+		case 4: myOut += "take x"; break;
+		case 5: myOut += "f(x, \"s\")"; break;
+		default:
+			myOut += "y : int = ";
+			exp(below(3));
+			break;
+		}
+		myOut += ";\n";
+	}
+
+	/* Statements at depth, with blocks nested levels further */
+	void block(int depth, int levels){
+		size_t count = below(3) + 1;
+		for (size_t i = 0; i < count; i++){ stmt(depth); }
+		if (levels == 0){ return; }
+		indent(depth);
+		bool isIf = below(2) == 0;
+		myOut += isIf ? "if (" : "while (";
+		exp(below(3) + 1);
+		myOut += ") {\n";
+		block(depth + 1, levels - 1);
+		indent(depth);
+		if (isIf && below(3) == 0){
+			myOut += "} else {\n";
+			block(depth + 1, 0);
+			indent(depth);
+		}
+		myOut += "}\n";
+	}
+
+	void function(int levels){
+		myOut += name("fn");
+		myOut += " : (x : int, b : bool, o : Obj) int {\n";
+		block(1, levels);
+		myOut += "\treturn x;\n}\n";
+	}
+
+	void chains(){
+		myOut += name("c");
+		myOut += " : () void {\n";
+		for (int i = 0; i < 4; i++){
+			myOut += "\tx = ";
+			exp(below(200) + 50);
+			myOut += ";\n";
+		}
+		myOut += "}\n";
+	}
+
+	void classDecl(){
+		myOut += name("Cls");
+		myOut += " : class {\n";
+		size_t fields = below(40) + 20;
+		for (size_t i = 0; i < fields; i++){
+			myOut += "\t";
+			myOut += name("m");
+			myOut += below(2) ? " : int;\n" : " : perfect bool = false;\n";
+		}
+		size_t methods = below(10) + 5;
+		for (size_t i = 0; i < methods; i++){
+			myOut += "\t";
+			myOut += name("meth");
+			myOut += " : (x : int) int {\n";
+			block(2, 2);
+			myOut += "\t\treturn x;\n\t}\n";
+		}
+		myOut += "};\n";
+	}
+
+	void strings(){
+		myOut += name("s");
+		myOut += " : () void {\n";
+		size_t count = below(50) + 10;
+		for (size_t i = 0; i < count; i++){
+			myOut += "\tgive \"";
+			size_t len = below(60) + 1;
+			for (size_t c = 0; c < len; c++){
+				myOut += static_cast<char>('a' + below(26));
+			}
+			myOut += below(4) == 0 ? "\\n\";\n" : "\";\n";
+		}
+		myOut += "}\n";
+	}
+
+	std::mt19937 myRandom;
+	std::string myOut;
+	size_t myNames = 0;
+};
+
+}
+
+int main(int argc, char * argv[]){
+	if (argc < 3){
+		std::cerr << "Usage: generate <globals|nesting|expressions"
+		  << "|classes|strings|mixed> <kilobytes> [seed]\n";
+		return 1;
+	}
+	static const char * const shapes[] = {
+		"globals", "nesting", "expressions", "classes", "strings", "mixed"
+	};
+	bool known = false;
+	for (const char * shape : shapes){
+		if (std::strcmp(shape, argv[1]) == 0){ known = true; }
+	}
+	if (!known){
+		std::cerr << "Unknown shape " << argv[1] << "\n";
+		return 1;
+	}
+	size_t kilobytes = std::strtoul(argv[2], nullptr, 10);
+	unsigned seed = argc > 3
+	  ? static_cast<unsigned>(std::strtoul(argv[3], nullptr, 10)) : 1;
+	Generator(seed).run(argv[1], kilobytes * 1024);
+	return 0;
+}
@@ -0,0 +1,221 @@
+/*
+Times each phase of the front end on one input and prints a
+tab-separated row per phase:
+
+    file  phase  scanner  bytes  tokens  nodes  seconds  MB/s  tokens/s  peakRSS(KB)
+
+seconds is the best of the repeated runs, and MB/s and tokens/s are
+the input's size and token count over that time. Peak RSS is the
+high-water mark of resident memory during the phase's runs alone
+(the mark is reset before each phase), so it still includes what
+earlier phases kept but not what they freed. Without
+/proc/self/clear_refs it falls back to the whole process's mark.
+
+    harness [-s flex|fast] [-r repeats] <file>
+    harness -H        (print the header line)
+*/
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include "errors.hpp"
+#include "diagnostics.hpp"
+#include "source.hpp"
+#include "scanner.hpp"
+#include "fastscanner.hpp"
+#include "astbuilder.hpp"
+#include "flatast.hpp"
+#include "writer.hpp"
+
+using namespace drewno_mars;
+
+namespace {
+
+double now(){
+	using Clock = std::chrono::steady_clock;
+	return std::chrono::duration<double>(
+	  Clock::now().time_since_epoch()).count();
+}
+
+/* Start a new high-water mark of resident memory, where Linux
+   allows it */
+void resetPeak(){
+	std::ofstream refs("/proc/self/clear_refs");
+	if (refs.good()){ refs << "5"; }
+}
+
+/* The resident high-water mark since the last resetPeak(), in KB */
+long peakKB(){
+	std::ifstream status("/proc/self/status");
+	std::string line;
+	while (std::getline(status, line)){
+		if (line.compare(0, 6, "VmHWM:") == 0){
+			return atol(line.c_str() + 6);
+		}
+	}
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss;
+}
+
+class Harness{
+public:
+	Harness(const char * path, bool fast, int repeats)
+	: mySource(path), myPath(path), myFast(fast), myRepeats(repeats){ }
+
+	void run(){
+		scan();
+		parseFlat();
+		parse();
+		unparse();
+	}
+private:
+	std::unique_ptr<Lexer> lexer(DiagnosticEngine& diags){
+		if (myFast){ return std::unique_ptr<Lexer>(
+		  new FastScanner(&mySource, &diags)); }
+		return std::unique_ptr<Lexer>(new Scanner(&mySource, &diags));
+	}
+
+	void scan(){
+		resetPeak();
+		double best = 0;
+		for (int i = 0; i < myRepeats; i++){
+			DiagnosticEngine diags;
+			myTokens.clear();
+			std::unique_ptr<Lexer> scanner = lexer(diags);
+			double start = now();
+			scanner->fill(myTokens);
+			best = fastest(best, now() - start, i);
+		}
+		report("scan", best);
+	}
+
+	void parse(){
+		resetPeak();
+		double best = 0;
+		for (int i = 0; i < myRepeats; i++){
+			DiagnosticEngine diags;
+			myArena.reset(new Arena());
+			PointerBuilder builder(*myArena);
+			TokenBufferReader reader(myTokens);
+			Parser parser(reader, builder, diags);
+			double start = now();
+			if (parser.parse() != 0 || diags.count(Severity::ERROR) != 0){
+				throw new UserError("The input has a syntax error");
+			}
+			best = fastest(best, now() - start, i);
+			myAST = builder.root();
+		}
+		report("parse", best);
+	}
+
+	void parseFlat(){
+		resetPeak();
+		double best = 0;
+		for (int i = 0; i < myRepeats; i++){
+			DiagnosticEngine diags;
+			FlatAST tree;
+			FlatBuilder builder(tree);
+			TokenBufferReader reader(myTokens);
+			Parser parser(reader, builder, diags);
+			double start = now();
+			if (parser.parse() != 0 || diags.count(Severity::ERROR) != 0){
+				throw new UserError("The input has a syntax error");
+			}
+			best = fastest(best, now() - start, i);
+			myNodes = tree.size();
+		}
+		report("parse-flat", best);
+	}
+
+	void unparse(){
+		int fd = open("/dev/null", O_WRONLY);
+		if (fd < 0){ throw new UserError("Can't open /dev/null"); }
+		resetPeak();
+		double best = 0;
+		for (int i = 0; i < myRepeats; i++){
+			Writer out(fd);
+			double start = now();
+			myAST->unparse(out, 0);
+			out.flush();
+			best = fastest(best, now() - start, i);
+		}
+		close(fd);
+		report("unparse", best);
+	}
+
+	static double fastest(double best, double time, int run){
+		return run == 0 || time < best ? time : best;
+	}
+
+	void report(const char * phase, double seconds){
+		double bytes = static_cast<double>(mySource.size());
+		double tokens = static_cast<double>(myTokens.size());
+		std::cout << myPath << '\t' << phase << '\t'
+		  << (myFast ? "fast" : "flex") << '\t'
+		  << mySource.size() << '\t' << myTokens.size() << '\t'
+		  << myNodes << '\t'
+		  << std::fixed << std::setprecision(6) << seconds << '\t'
+		  << std::setprecision(2) << bytes / seconds / 1e6 << '\t'
+		  << std::setprecision(0) << tokens / seconds << '\t'
+		  << peakKB() << '\n';
+		std::cout.unsetf(std::ios::floatfield);
+	}
+
+	SourceBuffer mySource;
+	const char * myPath;
+	bool myFast;
+	int myRepeats;
+	TokenBuffer myTokens;
+	std::unique_ptr<Arena> myArena;
+	ProgramNode * myAST = nullptr;
+	size_t myNodes = 0;
+};
+
+void usageAndDie(){
+	std::cerr << "Usage: harness [-s flex|fast] [-r repeats] <file>\n"
+	  << "       harness -H: print the header line\n";
+	exit(1);
+}
+
+}
+
+int main(int argc, char * argv[]){
+	bool fast = false;
+	int repeats = 3;
+	const char * path = nullptr;
+	for (int i = 1; i < argc; i++){
+		if (strcmp(argv[i], "-H") == 0){
+			std::cout << "file\tphase\tscanner\tbytes\ttokens\tnodes"
+			  << "\tseconds\tMB/s\ttokens/s\tpeakRSS(KB)\n";
+			return 0;
+		} else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc){
+			const char * scanner = argv[++i];
+			if (strcmp(scanner, "fast") == 0){ fast = true; }
+			else if (strcmp(scanner, "flex") == 0){ fast = false; }
+			else { usageAndDie(); }
+		} else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc){
+			repeats = atoi(argv[++i]);
+		} else if (path == nullptr){
+			path = argv[i];
+		} else {
+			usageAndDie();
+		}
+	}
+	if (path == nullptr || repeats < 1){ usageAndDie(); }
+	try {
+		Harness(path, fast, repeats).run();
+	} catch (UserError * e){
+		std::cerr << path << ": " << e->msg() << "\n";
+		return 1;
+	}
+	return 0;
+}
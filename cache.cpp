@@ -0,0 +1,213 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "cache.hpp"
+#include "errors.hpp"
+#include "hash.hpp"
+#include "tokenbuffer.hpp"
+
+namespace drewno_mars{
+
+/* Bump the version whenever the entry layout changes */
+static const char MAGIC[] = "dmc-cache 1\n";
+static const size_t MAGIC_LEN = sizeof(MAGIC) - 1;
+
+/* Read all of fd into text; false on a read error */
+static bool readAll(int fd, std::string& text){
+	char buf[64 * 1024];
+	for (;;){
+		ssize_t n = ::read(fd, buf, sizeof(buf));
+		if (n < 0 && errno == EINTR){ continue; }
+		if (n < 0){ return false; }
+		if (n == 0){ return true; }
+		text.append(buf, static_cast<size_t>(n));
+	}
+}
+
+static bool writeAll(int fd, const std::string& text){
+	const char * p = text.data();
+	size_t left = text.size();
+	while (left > 0){
+		ssize_t n = ::write(fd, p, left);
+		if (n < 0){
+			if (errno == EINTR){ continue; }
+			return false;
+		}
+		p += n;
+		left -= static_cast<size_t>(n);
+	}
+	return true;
+}
+
+/* Tells one build of dmc from another. The Makefile passes in a
+   checksum of the sources; without one, where the executable sits
+   on disk and when it was written stand in for it. */
+static uint64_t buildID(){
+#ifdef DMC_BUILD_ID
+	static const char id[] = DMC_BUILD_ID;
+	return contentHash(id, sizeof(id) - 1);
+#else
+	struct stat info;
+	if (stat("/proc/self/exe", &info) != 0){
+		static const char id[] = __DATE__ " " __TIME__;
+		return contentHash(id, sizeof(id) - 1);
+	}
+	uint64_t exe[] = {
+		static_cast<uint64_t>(info.st_dev),
+		static_cast<uint64_t>(info.st_ino),
+		static_cast<uint64_t>(info.st_mtim.tv_sec),
+		static_cast<uint64_t>(info.st_mtim.tv_nsec),
+		static_cast<uint64_t>(info.st_size)
+	};
+	return contentHash(reinterpret_cast<const char *>(exe), sizeof(exe));
+#endif
+}
+
+static void putU32(std::string& out, size_t value){
+	uint32_t word = static_cast<uint32_t>(value);
+	out.append(reinterpret_cast<const char *>(&word), sizeof(word));
+}
+
+static void putText(std::string& out, const std::string& text){
+	uint64_t len = text.size();
+	out.append(reinterpret_cast<const char *>(&len), sizeof(len));
+	out += text;
+}
+
+/* Reads an entry back, refusing to run past its end */
+class EntryReader{
+public:
+	explicit EntryReader(const std::string& text)
+	: myCur(text.data()), myEnd(text.data() + text.size()){ }
+
+	bool bytes(void * to, size_t len){
+		if (static_cast<size_t>(myEnd - myCur) < len){ return false; }
+		memcpy(to, myCur, len);
+		myCur += len;
+		return true;
+	}
+	bool u32(size_t& value){
+		uint32_t word;
+		if (!bytes(&word, sizeof(word))){ return false; }
+		value = word;
+		return true;
+	}
+	bool text(std::string& value){
+		uint64_t len;
+		if (!bytes(&len, sizeof(len))){ return false; }
+		if (static_cast<uint64_t>(myEnd - myCur) < len){ return false; }
+		value.assign(myCur, static_cast<size_t>(len));
+		myCur += len;
+		return true;
+	}
+	bool done() const { return myCur == myEnd; }
+private:
+	const char * myCur;
+	const char * myEnd;
+};
+
+OutputCache::OutputCache(const char * path)
+: myDir(path), myBuildID(buildID()), myHits(0), myMisses(0), myTemps(0){
+	struct stat info;
+	if (mkdir(path, 0777) != 0 && errno != EEXIST){
+		std::string msg = "Bad cache directory ";
+		msg += path;
+		throw new UserError(msg.c_str());
+	}
+	if (stat(path, &info) != 0 || !S_ISDIR(info.st_mode)){
+		std::string msg = "Bad cache directory ";
+		msg += path;
+		throw new UserError(msg.c_str());
+	}
+}
+
+std::string OutputCache::key(const char * data, size_t len,
+  bool buffered, size_t depthLimit) const{
+	char name[40];
+	snprintf(name, sizeof(name), "%016llx-%016llx%s",
+	  static_cast<unsigned long long>(contentHash(data, len)),
+	  static_cast<unsigned long long>(myBuildID), buffered ? "" : "-s");
+	if (depthLimit != DEFAULT_DEPTH_LIMIT){
+		return name + std::string("-d") + std::to_string(depthLimit);
+	}
+	return name;
+}
+
+bool OutputCache::load(const std::string& key, Entry& entry){
+	std::string text;
+	int fd = open((myDir + "/" + key).c_str(), O_RDONLY);
+	if (fd >= 0){
+		if (!readAll(fd, text)){ text.clear(); }
+		close(fd);
+	}
+
+	EntryReader reader(text);
+	char magic[MAGIC_LEN];
+	uint8_t parsed;
+	size_t count;
+	bool ok = reader.bytes(magic, MAGIC_LEN)
+	  && memcmp(magic, MAGIC, MAGIC_LEN) == 0
+	  && reader.bytes(&parsed, 1) && reader.u32(count);
+	std::string arg;
+	for (size_t i = 0; ok && i < count; i++){
+		uint8_t severity;
+		uint8_t id;
+		size_t lineI, colI, lineE, colE;
+		ok = reader.bytes(&severity, 1) && reader.bytes(&id, 1)
+		  && severity <= static_cast<uint8_t>(Severity::NOTE)
+		  && id <= static_cast<uint8_t>(DiagID::TEXT)
+		  && reader.u32(lineI) && reader.u32(colI)
+		  && reader.u32(lineE) && reader.u32(colE)
+		  && reader.text(arg);
+		if (ok){
+			entry.diags.report(static_cast<Severity>(severity),
+			  static_cast<DiagID>(id),
+			  Position(lineI, colI, lineE, colE), arg);
+		}
+	}
+	ok = ok && reader.text(entry.tokens) && reader.text(entry.unparsed)
+	  && reader.done();
+	if (!ok){
+		// Missing or damaged; whatever was read is thrown away
+		entry = Entry();
+		myMisses++;
+		return false;
+	}
+	entry.parsed = parsed != 0;
+	myHits++;
+	return true;
+}
+
+void OutputCache::store(const std::string& key, const Entry& entry){
+	std::string text(MAGIC, MAGIC_LEN);
+	text += static_cast<char>(entry.parsed ? 1 : 0);
+	const std::vector<Diagnostic>& diags = entry.diags.diagnostics();
+	putU32(text, diags.size());
+	for (const Diagnostic& diag : diags){
+		text += static_cast<char>(diag.severity);
+		text += static_cast<char>(diag.id);
+		putU32(text, diag.span.lineBegin());
+		putU32(text, diag.span.colBegin());
+		putU32(text, diag.span.lineEnd());
+		putU32(text, diag.span.colEnd());
+		putText(text, entry.diags.arg(diag));
+	}
+	putText(text, entry.tokens);
+	putText(text, entry.unparsed);
+
+	std::string path = myDir + "/" + key;
+	std::string temp = path + ".tmp." + std::to_string(getpid())
+	  + "." + std::to_string(myTemps++);
+	int fd = open(temp.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0666);
+	if (fd < 0){ return; }
+	bool written = writeAll(fd, text);
+	written = close(fd) == 0 && written;
+	if (!written || rename(temp.c_str(), path.c_str()) != 0){
+		unlink(temp.c_str());
+	}
+}
+
+}
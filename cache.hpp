@@ -0,0 +1,68 @@
+#ifndef DREWNO_MARS_CACHE_H
+#define DREWNO_MARS_CACHE_H
+
+#include <atomic>
+#include <string>
+#include "diagnostics.hpp"
+
+namespace drewno_mars{
+
+/**
+* \class OutputCache
+* A directory of finished front-end results that any number of dmc
+* processes can share. An entry is named by a hash of the input's
+* bytes and of the dmc binary itself, so a rebuilt compiler never
+* trusts its predecessor's entries. It holds the token dump, whether
+* the parse succeeded, the diagnostics, and the unparsed program, so
+* a hit writes the stored text back without scanning anything.
+*
+* Entries are written to a temporary file and renamed into place:
+* a reader sees a whole entry or none. Two processes storing the
+* same key write the same bytes, so it doesn't matter who wins.
+**/
+class OutputCache{
+public:
+	struct Entry{
+		bool parsed = false;
+		/* Everything the compilation reported, with no limit */
+		DiagnosticEngine diags;
+		/* The -t dump; only kept for buffered runs */
+		std::string tokens;
+		/* The -u output, if the input parsed */
+		std::string unparsed;
+	};
+
+	/** Use the directory at path, creating it if needed. Throws a
+	    UserError if that fails **/
+	explicit OutputCache(const char * path);
+
+	/** The name of the entry for an input. A streaming run
+	    reports each lexical error as the parser reaches it, among
+	    the syntax errors, and none past a --max-depth cutoff; a
+	    buffered run reports them all first. So the two are kept
+	    apart, as is a run with other than the default parser
+	    depth limit. **/
+	std::string key(const char * data, size_t len, bool buffered,
+	  size_t depthLimit) const;
+
+	/** Fill entry from the cache; false (a miss) if there is no
+	    readable entry under key **/
+	bool load(const std::string& key, Entry& entry);
+	/** Add entry under key. A cache that can't be written to only
+	    costs time, so failures are ignored. **/
+	void store(const std::string& key, const Entry& entry);
+
+	size_t hits() const { return myHits; }
+	size_t misses() const { return myMisses; }
+private:
+	std::string myDir;
+	uint64_t myBuildID;
+	std::atomic<size_t> myHits;
+	std::atomic<size_t> myMisses;
+	/* Numbers this process's temporary files */
+	std::atomic<size_t> myTemps;
+};
+
+}
+
+#endif
@@ -0,0 +1,102 @@
+#include "compilation.hpp"
+#include "astbuilder.hpp"
+
+namespace drewno_mars{
+
+using TokenKind = drewno_mars::Parser::token;
+
+namespace {
+
+/* Passes the scanner's tokens through to the parser, counting each
+   into stats, when there is no buffer to count them from after */
+class CountingSource : public TokenSource{
+public:
+	CountingSource(TokenSource& source, Stats * stats)
+	: mySource(source), myStats(stats){ }
+	int nextToken(Parser::semantic_type * lval) override{
+		int kind = mySource.nextToken(lval);
+		myLastSpan = mySource.lastSpan();
+		myStats->countToken(kind);
+		return kind;
+	}
+private:
+	TokenSource& mySource;
+	Stats * myStats;
+};
+
+}
+
+Compilation::Compilation(const char * inPath, DiagnosticEngine& diags,
+  ScannerKind scanner)
+: myDiags(diags), mySource(new SourceBuffer(inPath)){
+	if (scanner == ScannerKind::FAST){
+		myLexer.reset(new FastScanner(mySource.get(), &diags));
+	} else {
+		myLexer.reset(new Scanner(mySource.get(), &diags));
+	}
+}
+
+void Compilation::setStats(Stats * stats){
+	myStats = stats;
+	myArena.setProfile(stats == nullptr ? nullptr : stats->arenaProfile());
+}
+
+void Compilation::run(bool wantTokens, bool wantAST){
+	if (myStats != nullptr){ myStats->addRead(mySource->size()); }
+	if (wantTokens || myBuffered){
+		{
+			Stats::Phase phase(myStats, "scan");
+			myLexer->fill(myTokens);
+		}
+		if (myStats != nullptr){ myStats->countTokens(myTokens); }
+		if (wantAST){
+			TokenBufferReader reader(myTokens);
+			parseFrom(reader);
+		}
+	} else if (wantAST && myStats != nullptr){
+		CountingSource counted(*myLexer, myStats);
+		parseFrom(counted);
+	} else if (wantAST){
+		parseFrom(*myLexer);
+	}
+}
+
+void Compilation::parseFrom(TokenSource& tokens){
+	PointerBuilder pointers(myArena);
+	FlatBuilder flat(myFlat);
+	ASTBuilder * builder = &pointers;
+	if (myFlatMode){
+		// Typical programs run about six bytes to a node
+		myFlat.clear();
+		myFlat.reserve(mySource->size() / 6);
+		builder = &flat;
+	}
+	tokens.setDepthLimit(myDepthLimit);
+	Parser parser(tokens, *builder, myDiags);
+	size_t errors = myDiags.count(Severity::ERROR);
+	bool finished;
+	{
+		// Streaming, this includes the scan
+		Stats::Phase phase(myStats, "parse");
+		finished = parser.parse() == 0;
+	}
+	// The parser recovers from syntax errors, so it can finish anyway
+	myParsed = finished && myDiags.count(Severity::ERROR) == errors;
+	if (finished){
+		myAST = myFlatMode ? expandAST(myFlat, myArena) : pointers.root();
+		if (myStats != nullptr && myAST != nullptr){
+			myStats->countNodes(myAST);
+		}
+	}
+}
+
+void Compilation::release(){
+	myLexer.reset();
+	mySource.reset();
+}
+
+void Compilation::writeTokens(Writer& out) const{
+	myTokens.write(out);
+}
+
+}
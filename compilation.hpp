@@ -0,0 +1,98 @@
+#ifndef DREWNO_MARS_COMPILATION_H
+#define DREWNO_MARS_COMPILATION_H
+
+#include <memory>
+#include <ostream>
+#include "arena.hpp"
+#include "source.hpp"
+#include "scanner.hpp"
+#include "fastscanner.hpp"
+#include "ast.hpp"
+#include "flatast.hpp"
+#include "stats.hpp"
+
+namespace drewno_mars{
+
+/* Which scanner reads the input. Both give the same tokens and 
+   diagnostics; FAST is the hand-written one. */
+enum class ScannerKind { FLEX, FAST };
+
+/**
+* \class Compilation
+* One run of the front end over one input file. The file is read 
+* and scanned exactly once, and every requested output (token dump,
+* parse check, unparse) is produced from those shared results.
+*
+* In buffered mode the scanner first fills a TokenBuffer with the
+* whole stream and the parser then reads from that buffer, so the
+* two phases run (and can be measured) separately. In streaming
+* mode the parser pulls straight from the scanner, and the tokens
+* are only recorded if a dump was asked for.
+**/
+class Compilation{
+public:
+	/** Every message for the user is collected in diags **/
+	Compilation(const char * inPath, DiagnosticEngine& diags,
+	  ScannerKind scanner = ScannerKind::FLEX);
+
+	/** Scan the input and, if wantAST is set, parse it. When 
+	    wantTokens is set the complete token stream (through EOF)
+	    is kept even if the parse stops early. Asking for the
+	    tokens implies buffered mode. **/
+	void run(bool wantTokens, bool wantAST);
+
+	/** Force buffered mode even when no dump is wanted **/
+	void setBuffered(bool buffered){ myBuffered = buffered; }
+
+	/** Have the parser build a FlatAST, which ast() is then 
+	    expanded from **/
+	void setFlat(bool flat){ myFlatMode = flat; }
+
+	/** Give up on input that nests the parser's stack deeper
+	    than limit symbols (0 = no limit) **/
+	void setDepthLimit(size_t limit){ myDepthLimit = limit; }
+
+	/** Time the scan and parse and count what they made into
+	    stats, or nothing if it is null **/
+	void setStats(Stats * stats);
+
+	/** Write the recorded token stream in the -t format **/
+	void writeTokens(Writer& out) const;
+
+	/** True if the input parsed without a syntax error **/
+	bool parsed() const { return myParsed; }
+	/** Root of the AST, or nullptr if the parser gave up. After
+	    syntax errors it recovered from, this is the partial tree
+	    of what did parse, and parsed() is false. The tree lives
+	    in this compilation's arena. **/
+	ProgramNode * ast() const { return myAST; }
+	/** The tree built in flat mode, empty otherwise **/
+	const FlatAST& flat() const { return myFlat; }
+	const TokenBuffer& tokens() const { return myTokens; }
+	/** The input text; gone after release() **/
+	const SourceBuffer& source() const { return *mySource; }
+
+	/** Free the source text and the scanner once run() is done,
+	    for compilations that are kept around. The tokens, the
+	    diagnostics and the AST stay. **/
+	void release();
+private:
+	void parseFrom(TokenSource& tokens);
+
+	DiagnosticEngine& myDiags;
+	std::unique_ptr<SourceBuffer> mySource;
+	Arena myArena;
+	std::unique_ptr<Lexer> myLexer;
+	TokenBuffer myTokens;
+	FlatAST myFlat;
+	bool myBuffered = false;
+	bool myFlatMode = false;
+	size_t myDepthLimit = DEFAULT_DEPTH_LIMIT;
+	bool myParsed = false;
+	ProgramNode * myAST = nullptr;
+	Stats * myStats = nullptr;
+};
+
+}
+
+#endif
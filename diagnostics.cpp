@@ -0,0 +1,108 @@
+#include <cstring>
+#include <mutex>
+#include "diagnostics.hpp"
+
+namespace drewno_mars{
+
+// Held while any engine writes, so parallel flushes don't interleave
+static std::mutex flushLock;
+
+static const char * messageText(DiagID id){
+	switch(id){
+		case DiagID::ILLEGAL_CHAR: return "Illegal character ";
+		case DiagID::STR_BAD_ESC: 
+			return "String literal with bad escape sequence ignored";
+		case DiagID::STR_UNTERM: 
+			return "Unterminated string literal ignored";
+		case DiagID::STR_BAD_ESC_UNTERM: 
+			return "Unterminated string literal with bad escape"
+			" sequence ignored";
+		case DiagID::INT_OVERFLOW: return "Integer literal overflow";
+		case DiagID::SYNTAX: return "syntax error";
+		case DiagID::TOO_DEEP:
+			return "Nested too deeply to parse; the parser's stack"
+			" is limited to ";
+		case DiagID::PARSE_FAILED: return "Parse failed";
+		case DiagID::NO_AST: return "No AST built";
+		case DiagID::TEXT: return "";
+	}
+	return "";
+}
+
+void DiagnosticEngine::report(Severity severity, DiagID id, 
+  const Position& span, const char * arg, size_t argLength){
+	myCounts[static_cast<size_t>(severity)]++;
+	if (severity != Severity::NOTE){
+		myErrors++;
+		if (myLimit != 0 && myErrors > myLimit){
+			myDropped++;
+			return;
+		}
+	}
+	if (argLength == SIZE_MAX){ argLength = strlen(arg); }
+	Diagnostic diag;
+	diag.severity = severity;
+	diag.id = id;
+	diag.span = span;
+	diag.argBegin = static_cast<uint32_t>(myArgs.size());
+	diag.argLength = static_cast<uint32_t>(argLength);
+	myArgs.append(arg, argLength);
+	myDiags.push_back(diag);
+}
+
+void DiagnosticEngine::note(DiagID id, const std::string& text){
+	report(Severity::NOTE, id, Position(0,0,0,0), text);
+}
+
+std::string DiagnosticEngine::message(const Diagnostic& diag) const{
+	if (diag.id == DiagID::TEXT){ return arg(diag); }
+	if (diag.id == DiagID::SYNTAX){ return messageText(diag.id); }
+	return messageText(diag.id) + arg(diag);
+}
+
+void DiagnosticEngine::flush(std::ostream& out, std::ostream& err){
+	std::string outText;
+	std::string errText;
+	for (const Diagnostic& diag : myDiags){
+		switch (diag.severity){
+		case Severity::FATAL:
+			errText += "FATAL ";
+			errText += diag.span.span();
+			errText += ": ";
+			errText += message(diag);
+			errText += "\n";
+			break;
+		case Severity::ERROR:
+			// Syntax errors also print the parser's details
+			if (diag.id == DiagID::SYNTAX){
+				outText.append(myArgs, diag.argBegin, diag.argLength);
+				outText += "\n";
+			}
+			errText += "ERROR ";
+			errText += diag.span.span();
+			errText += ": ";
+			errText += message(diag);
+			errText += "\n";
+			break;
+		case Severity::NOTE:
+			errText += message(diag);
+			errText += "\n";
+			break;
+		}
+	}
+	if (myDropped > 0){
+		errText += std::to_string(myDropped) 
+		  + " more errors not shown\n";
+	}
+	myDiags.clear();
+	myArgs.clear();
+	myDropped = 0;
+
+	std::lock_guard<std::mutex> guard(flushLock);
+	out.write(outText.data(), static_cast<std::streamsize>(outText.size()));
+	out.flush();
+	err.write(errText.data(), static_cast<std::streamsize>(errText.size()));
+	err.flush();
+}
+
+}
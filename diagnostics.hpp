@@ -0,0 +1,94 @@
+#ifndef DREWNO_MARS_DIAGNOSTICS_H
+#define DREWNO_MARS_DIAGNOSTICS_H
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "position.hpp"
+
+namespace drewno_mars{
+
+enum class Severity : uint8_t {
+	FATAL,  // Lexical errors, in the spec's "FATAL [span]: ..." form
+	ERROR,  // Syntax errors, as "ERROR [span]: syntax error"
+	NOTE    // Everything else meant for the user
+};
+
+/* Which message a diagnostic carries. The text for each lives in
+   diagnostics.cpp and is only built when the engine is flushed. */
+enum class DiagID : uint8_t {
+	ILLEGAL_CHAR,        // arg: the offending character
+	STR_BAD_ESC,
+	STR_UNTERM,
+	STR_BAD_ESC_UNTERM,
+	INT_OVERFLOW,
+	SYNTAX,              // arg: the parser's detailed message
+	TOO_DEEP,            // arg: the parser's depth limit
+	PARSE_FAILED,
+	NO_AST,
+	TEXT                 // arg: the whole message
+};
+
+struct Diagnostic{
+	Severity severity;
+	DiagID id;
+	Position span;
+	uint32_t argBegin;
+	uint32_t argLength;
+};
+
+/**
+* \class DiagnosticEngine
+* Collects the diagnostics of one compilation as compact records
+* and formats them all at once in flush(), with a single write per
+* stream. Each compilation has its own engine; flushes from engines
+* on different threads are serialized so their output never mixes.
+**/
+class DiagnosticEngine{
+public:
+	/** Keep at most limit FATAL/ERROR diagnostics (0 = no limit);
+	    the rest are only counted **/
+	DiagnosticEngine(size_t limit = 0) : myLimit(limit){ }
+
+	void report(Severity severity, DiagID id, const Position& span,
+	  const char * arg = "", size_t argLength = SIZE_MAX);
+	void report(Severity severity, DiagID id, const Position& span,
+	  const std::string& arg){
+		report(severity, id, span, arg.data(), arg.size());
+	}
+	/** A NOTE with free-form text and no position **/
+	void note(DiagID id, const std::string& text = "");
+
+	void setLimit(size_t limit){ myLimit = limit; }
+	bool empty() const { return myDiags.empty() && myDropped == 0; }
+	/** FATAL and ERROR diagnostics seen, including dropped ones **/
+	size_t errorCount() const { return myErrors; }
+	/** Diagnostics of one severity seen, including dropped ones **/
+	size_t count(Severity severity) const {
+		return myCounts[static_cast<size_t>(severity)];
+	}
+	const std::vector<Diagnostic>& diagnostics() const { return myDiags; }
+
+	/** The message of one diagnostic, as it would be printed **/
+	std::string message(const Diagnostic& diag) const;
+	/** The argument text the diagnostic was reported with **/
+	std::string arg(const Diagnostic& diag) const {
+		return myArgs.substr(diag.argBegin, diag.argLength);
+	}
+
+	/** Write everything collected so far to out (parser details)
+	    and err (everything else), then forget it **/
+	void flush(std::ostream& out, std::ostream& err);
+private:
+	std::vector<Diagnostic> myDiags;
+	std::string myArgs;
+	size_t myLimit;
+	size_t myErrors = 0;
+	size_t myCounts[3] = {0, 0, 0};
+	size_t myDropped = 0;
+};
+
+}
+
+#endif
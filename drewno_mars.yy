@@ -9,11 +9,11 @@
 %token-table
 
 %code requires{
-	#include <list>
 	#include "tokens.hpp"
-	#include "ast.hpp"
+	#include "astbuilder.hpp"
+	#include "diagnostics.hpp"
 	namespace drewno_mars {
-		class Scanner;
+		class TokenSource;
 	}
 
 //The following definition is required when 
@@ -29,8 +29,9 @@
 //End "requires" code
 }
 
-%parse-param { drewno_mars::Scanner &scanner }
-%parse-param { drewno_mars::ProgramNode** root }
+%parse-param { drewno_mars::TokenSource &tokens }
+%parse-param { drewno_mars::ASTBuilder &build }
+%parse-param { drewno_mars::DiagnosticEngine &diags }
 %code{
    // C std code for utility functions
    #include <iostream>
@@ -38,57 +39,40 @@
    #include <fstream>
 
    // Our code for interoperation between scanner/parser
-   #include "scanner.hpp"
-   #include "ast.hpp"
+   #include "tokenbuffer.hpp"
    #include "tokens.hpp"
 
-  //Request tokens from our scanner member, not 
-  // from a global function
+  //Request tokens from our token source (the scanner or
+  // a filled token buffer), not from a global function. The
+  // source is told how deep the stack is, so that it can cut
+  // off input nested past its limit.
   #undef yylex
-  #define yylex scanner.yylex
+  #define yylex(lval) \
+    tokens.nextTokenAt(static_cast<size_t>(yystack_.size()), lval, diags)
 }
 
 /*
 The %union directive is a way to specify the 
 set of possible types that might be used as
-translation attributes on a symbol.
-For this project, only terminals have types (we'll
-have translation attributes for non-terminals in the next
-project)
+translation attributes on a symbol. Terminals carry
+their token; nonterminals carry a node made by the
+ASTBuilder, or a list it is collecting.
 */
 %union {
-   drewno_mars::Token*                         transToken;
-   drewno_mars::Token*                         lexeme;
-   drewno_mars::IDToken*                       transIDToken;
-   drewno_mars::IntLitToken*                   transIntToken;
-   drewno_mars::StrToken*                      transStrToken;
-   drewno_mars::ProgramNode*                   transProgram;
-   drewno_mars::DeclNode *                     transDecl;
-   std::list<drewno_mars::DeclNode *> *        transDeclList;
-   drewno_mars::VarDeclNode *                  transVarDecl;
-   drewno_mars::TypeNode *                     transType;
-   drewno_mars::LocNode *                      transLoc;
-   drewno_mars::IDNode *                       transID;
-   drewno_mars::ClassDeclNode *                transClassDecl;
-   drewno_mars::FnDeclNode *                   transFnDecl;
-   drewno_mars::ExpNode *                      transExp;
-   drewno_mars::CallExpNode *                  transCallExp;
-   std::list<drewno_mars::ExpNode *> *         transActualsList;
-   drewno_mars::StmtNode *                     transStmt;
-   std::list<drewno_mars::StmtNode *> *        transStmtList;
-   drewno_mars::FormalDeclNode *               transFormalDecl;
-   std::list<drewno_mars::FormalDeclNode *> *  transFormalsList;
+   drewno_mars::Token                                      transToken;
+   drewno_mars::NodeRef                                    transNode;
+   drewno_mars::ListRef                                    transList;
 }
 
 %define parse.assert
 
 /* Terminals 
  *  No need to touch these, but do note the translation type
- *  of each node. Most are just "transToken", which is defined in
- *  the %union above to mean that the token translation is an instance
- *  of drewno_mars::Token *, and thus has no fields (other than line and column).
- *  Some terminals, like ID, are "transIDToken", meaning the translation
- *  also has a name field. 
+ *  of each node. Every terminal is a "transToken", which is defined in
+ *  the %union above to mean that the token translation is a
+ *  drewno_mars::Token value: a kind, a span, and a payload word.
+ *  For ID and STRINGLITERAL the payload is the interned handle of
+ *  the token's text, and for INTLITERAL it is the value itself.
 */
 %token                   END	   0 "end file"
 %token	<transToken>     AND
@@ -105,10 +89,10 @@ project)
 %token	<transToken>     GIVE
 %token	<transToken>     GREATER
 %token	<transToken>     GREATEREQ
-%token	<transIDToken>   ID
+%token	<transToken>     ID
 %token	<transToken>     IF
 %token	<transToken>     INT
-%token	<transIntToken>  INTLITERAL
+%token	<transToken>     INTLITERAL
 %token	<transToken>     LCURLY
 %token	<transToken>     LESS
 %token	<transToken>     LESSEQ
@@ -127,7 +111,7 @@ project)
 %token	<transToken>     SEMICOL
 %token	<transToken>     SLASH
 %token	<transToken>     STAR
-%token	<transStrToken>  STRINGLITERAL
+%token	<transToken>     STRINGLITERAL
 %token	<transToken>     TAKE
 %token	<transToken>     TRUE
 %token	<transToken>     VOID
@@ -144,27 +128,30 @@ project)
 *  attribute type).
 */
 /*    (attribute type)    (nonterminal)    */
-%type <transProgram> program
-%type <transDeclList> globals
-%type <transDecl> decl
-%type <transVarDecl> varDecl
-%type <transType> type
-%type <transType> primType
-%type <transLoc> loc
-%type <transID> id
-%type <transClassDecl> classDecl
-%type <transFnDecl> fnDecl
-%type <transExp> exp
-%type <transExp> term
-%type <transCallExp> callExp
-%type <transActualsList> actualsList
-%type <transStmt> stmt
-%type <transStmtList> stmtList
-%type <transStmt> blockStmt
-%type <transFormalDecl> formalDecl
-%type <transFormalsList> formals
-%type <transFormalsList> formalsList
-%type <transDeclList> classBody
+%type <transList> globals
+%type <transNode> decl
+%type <transNode> varDecl
+%type <transNode> type
+%type <transNode> primType
+%type <transNode> loc
+%type <transNode> id
+%type <transNode> classDecl
+%type <transNode> fnDecl
+%type <transNode> exp
+%type <transNode> term
+%type <transNode> callExp
+%type <transList> actualsList
+%type <transNode> stmt
+%type <transList> stmtList
+%type <transNode> blockStmt
+%type <transNode> formalDecl
+%type <transList> formals
+%type <transList> formalsList
+%type <transList> classBody
+
+/* Error recovery throws away the lists it pops unfinished, so that
+   their items don't end up in the list they were opened under */
+%destructor { build.discard($$); } <transList>
 
 %right ASSIGN
 %left OR
@@ -174,23 +161,35 @@ project)
 %left STAR SLASH
 %left NOT 
 
+/* Syntax errors are recovered from at declaration, class member and
+   statement boundaries: the parser skips ahead to a ';', which it
+   consumes, or to the next token that can begin another one, which
+   includes the '}' that closes the enclosing block. What parsed is
+   kept, so the tree is complete but for the skipped constructs. */
+
 %%
 
 program 	: globals
 		  {
-		  $$ = new ProgramNode($1);
-		  *root = $$;
+		  build.program($1);
 		  }
 
 globals 	: globals decl
 	  	  { 
 		  $$ = $1;
-		  DeclNode * declNode = $2;
-		  $$->push_back(declNode);
+		  build.push($2);
 	  	  }
+		| globals error SEMICOL
+		  {
+		  $$ = $1;
+		  }
+		| globals error
+		  {
+		  $$ = $1;
+		  }
 		| /* epsilon */
 		  {
-		  $$ = new std::list<DeclNode *>();
+		  $$ = build.openList();
 		  }
 
 decl 		: varDecl SEMICOL
@@ -204,15 +203,11 @@ decl 		: varDecl SEMICOL
 
 varDecl 	: id COLON type
 		  {
-		  const Position * p;
-		  p = new Position($1->pos(), $3->pos());
-		  $$ = new VarDeclNode(p, $1, $3);
+		  $$ = build.varDecl(build.span($1, $3), $1, $3, nullptr);
 		  }
 		| id COLON type ASSIGN exp
 		  {
-		  const Position * p;
-		  p = new Position($1->pos(), $5->pos());
-		  $$ = new VarDeclNode(p, $1, $3, $5);
+		  $$ = build.varDecl(build.span($1, $5), $1, $3, &$5);
 		  }
 
 type		: primType
@@ -221,64 +216,71 @@ type		: primType
 		  }
 		| id
 		  {
-		  const Position * pos = $1->pos();
-          $$ = new ClassTypeNode(pos, $1);
+		  $$ = build.unary(NodeKind::CLASS_TYPE, build.span($1), $1);
 		  }
 		| PERFECT primType
 		  {
-          const Position * p = new Position($1->pos(), $2->pos());
-          $$ = new PerfectTypeNode(p, $2);
+		  Position p($1.pos(), &build.span($2));
+		  $$ = build.unary(NodeKind::PERFECT_TYPE, p, $2);
 		  }
 		| PERFECT id
 		  {
-		  const Position * p = new Position($1->pos(), $2->pos());
-          ClassTypeNode * node = new ClassTypeNode(p, $2);
-          $$ = new PerfectTypeNode(p, node);
+		  Position p($1.pos(), &build.span($2));
+		  NodeRef named = build.unary(NodeKind::CLASS_TYPE, p, $2);
+		  $$ = build.unary(NodeKind::PERFECT_TYPE, p, named);
 		  }
 
 primType 	: INT
 	  	  { 
-		  $$ = new IntTypeNode($1->pos());
+		  $$ = build.leaf(NodeKind::INT_TYPE, *$1.pos());
 		  }
 		| BOOL
 		  {
-		  $$ = new BoolTypeNode($1->pos());
+		  $$ = build.leaf(NodeKind::BOOL_TYPE, *$1.pos());
 		  }
 		| VOID
 		  {
-		  $$ = new VoidTypeNode($1->pos());
+		  $$ = build.leaf(NodeKind::VOID_TYPE, *$1.pos());
 		  }
 
 classDecl	: id COLON CLASS LCURLY classBody RCURLY SEMICOL
 		  {
-		  const Position * p = new Position($1->pos(), $7->pos());
-          $$ = new ClassDeclNode(p, $1, $5);
+		  Position p(&build.span($1), $7.pos());
+		  $$ = build.listed(NodeKind::CLASS_DECL, p, $1, $5);
 		  }
 
 classBody	: classBody varDecl SEMICOL
 		  {
 		  $$ = $1;
-		  $$->push_back($2);
+		  build.push($2);
 		  }
 		| classBody fnDecl
 		  {
 		  $$ = $1;
-          $$->push_back($2);
+		  build.push($2);
+		  }
+		| classBody error SEMICOL
+		  {
+		  $$ = $1;
+		  }
+		| classBody error
+		  {
+		  $$ = $1;
 		  }
 		| /* epsilon */
 		  {
-		  $$ = new std::list<DeclNode *>();
+		  $$ = build.openList();
 		  }
 
 fnDecl  : id COLON LPAREN formals RPAREN type LCURLY stmtList RCURLY
 		  {
-		  const Position * p = new Position($1->pos(), $9->pos());
-		  $$ = new FnDeclNode(p, $6, $1, $4, $8);
+		  Position p(&build.span($1), $9.pos());
+		  $$ = build.fnDecl(p, $1, $4, $6, $8);
 		  }
 
 formals 	: /* epsilon */
 		  {
-		  $$ = new std::list<FormalDeclNode *>();
+		  $$ = build.openList();
 		  }
 		| formalsList
 		  {
@@ -287,50 +289,58 @@ formals 	: /* epsilon */
 
 formalsList 	: formalDecl
 		  {
-		  $$ = new std::list<FormalDeclNode *>();
-		  $$->push_back($1);
+		  $$ = build.openList();
+		  build.push($1);
 		  }
 		| formalsList COMMA formalDecl
 		  {
 		  $$ = $1;
-		  $$->push_back($3);
+		  build.push($3);
 		  }
 
 formalDecl 	: id COLON type
 		  {
-		  const Position * p = new Position($1->pos(), $3->pos());
-		  $$ = new FormalDeclNode(p, $1, $3);
+		  Position p = build.span($1, $3);
+		  $$ = build.binary(NodeKind::FORMAL_DECL, p, $1, $3);
 		  }
 
 stmtList 	: /* epsilon */
 	   	  {
-	   	  $$ = new std::list<StmtNode *>();
+	   	  $$ = build.openList();
 	   	  }
 		| stmtList stmt SEMICOL
 	  	  {
 	  	  $$ = $1;
-	  	  $$->push_back($2);
+	  	  build.push($2);
 	  	  }
 		| stmtList blockStmt
 	  	  {
 	  	  $$ = $1;
-	  	  $$->push_back($2);
+	  	  build.push($2);
 	  	  }
+		| stmtList error SEMICOL
+		  {
+		  $$ = $1;
+		  }
+		| stmtList error
+		  {
+		  $$ = $1;
+		  }
 
 blockStmt	: WHILE LPAREN exp RPAREN LCURLY stmtList RCURLY
 		  {
-		  const Position * p = new Position($1->pos(), $7->pos());
-		  $$ = new WhileStmtNode(p, $3, $6);
+		  Position p($1.pos(), $7.pos());
+		  $$ = build.listed(NodeKind::WHILE, p, $3, $6);
 		  }
 		| IF LPAREN exp RPAREN LCURLY stmtList RCURLY
 		  {
-		  const Position * p = new Position($1->pos(), $7->pos());
-          $$ = new IfStmtNode(p, $3, $6);
+		  Position p($1.pos(), $7.pos());
+		  $$ = build.listed(NodeKind::IF, p, $3, $6);
 		  }
 		| IF LPAREN exp RPAREN LCURLY stmtList RCURLY ELSE LCURLY stmtList RCURLY
 		  {
-		  const Position * p = new Position($1->pos(), $11->pos());
-          $$ = new IfElseStmtNode(p, $3, $6, $10);
+		  Position p($1.pos(), $11.pos());
+		  $$ = build.ifElse(p, $3, $6, $10);
 		  }
 
 stmt		: varDecl
@@ -339,119 +349,103 @@ stmt		: varDecl
 		  }
 		| loc ASSIGN exp
 		  {
-		  const Position * p = new Position($1->pos(), $3->pos());
-          $$ = new AssignStmtNode(p, $1, $3);
+		  $$ = build.binary(NodeKind::ASSIGN, build.span($1, $3), $1, $3);
 		  }
 		| loc POSTDEC
 		  {
-		  const Position * p = new Position($1->pos(), $2->pos());
-          $$ = new PostDecStmtNode(p, $1);
+		  Position p(&build.span($1), $2.pos());
+		  $$ = build.unary(NodeKind::POST_DEC, p, $1);
 		  }
 		| loc POSTINC
 		  {
-		  const Position * p = new Position($1->pos(), $2->pos());
-          $$ = new PostIncStmtNode(p, $1);
+		  Position p(&build.span($1), $2.pos());
+		  $$ = build.unary(NodeKind::POST_INC, p, $1);
 		  }
 		| GIVE exp
 		  {
-		  const Position * p = new Position($1->pos(), $2->pos());
-          $$ = new GiveStmtNode(p, $2);
+		  Position p($1.pos(), &build.span($2));
+		  $$ = build.unary(NodeKind::GIVE, p, $2);
 		  }
 		| TAKE loc
 		  {
-		  const Position * p = new Position($1->pos(), $2->pos());
-          $$ = new TakeStmtNode(p, $2);
+		  Position p($1.pos(), &build.span($2));
+		  $$ = build.unary(NodeKind::TAKE, p, $2);
 		  }
 		| RETURN exp
 		  {
-		  const Position * p = new Position($1->pos(), $2->pos());
-          $$ = new ReturnStmtNode(p, $2);
+		  Position p($1.pos(), &build.span($2));
+		  $$ = build.unary(NodeKind::RETURN, p, $2);
 		  }
 		| RETURN
 		  {
-		  const Position * pos = $1->pos();
-          $$ = new ReturnStmtNode(pos, nullptr);
+		  $$ = build.leaf(NodeKind::RETURN, *$1.pos());
 		  }
 		| EXIT
 		  {
-		   const Position * pos = $1->pos();
-           $$ = new ExitStmtNode(pos);
+		  $$ = build.leaf(NodeKind::EXIT, *$1.pos());
 		  }
 		| callExp
 		  {
-		  const Position * pos = $1->pos();
-          $$ = new CallStmtNode(pos, $1);
+		  $$ = build.unary(NodeKind::CALL_STMT, build.span($1), $1);
 		  }
 
 exp		: exp DASH exp
 	  	  {
-	  	  const Position * p = new Position($1->pos(), $3->pos());
-          $$ = new MinusNode(p, $1, $3);
+		  $$ = build.binary(NodeKind::MINUS, build.span($1, $3), $1, $3);
 		  }
 		| exp CROSS exp
 	  	  {
-	  	  const Position * p = new Position($1->pos(), $3->pos());
-          $$ = new PlusNode(p, $1, $3);
+		  $$ = build.binary(NodeKind::PLUS, build.span($1, $3), $1, $3);
 		  }
 		| exp STAR exp
 	  	  {
-	  	  const Position * p = new Position($1->pos(), $3->pos());
-          $$ = new TimesNode(p, $1, $3);
+		  $$ = build.binary(NodeKind::TIMES, build.span($1, $3), $1, $3);
 		  }
 		| exp SLASH exp
 	  	  {
-	  	  const Position * p = new Position($1->pos(), $3->pos());
-          $$ = new DivideNode(p, $1, $3);
+		  $$ = build.binary(NodeKind::DIVIDE, build.span($1, $3), $1, $3);
 		  }
 		| exp AND exp
 	  	  {
-	  	  const Position * p = new Position($1->pos(), $3->pos());
-          $$ = new AndNode(p, $1, $3);
+		  $$ = build.binary(NodeKind::AND, build.span($1, $3), $1, $3);
 		  }
 		| exp OR exp
 	  	  {
-	  	  const Position * p = new Position($1->pos(), $3->pos());
-          $$ = new OrNode(p, $1, $3);
+		  $$ = build.binary(NodeKind::OR, build.span($1, $3), $1, $3);
 		  }
 		| exp EQUALS exp
 	  	  {
-	  	  const Position * p = new Position($1->pos(), $3->pos());
-          $$ = new EqualsNode(p, $1, $3);
+		  $$ = build.binary(NodeKind::EQUALS, build.span($1, $3), $1, $3);
 		  }
 		| exp NOTEQUALS exp
 	  	  {
-	  	  const Position * p = new Position($1->pos(), $3->pos());
-          $$ = new NotEqualsNode(p, $1, $3);
+		  $$ = build.binary(NodeKind::NOT_EQUALS, build.span($1, $3), $1, $3);
 		  }
 		| exp GREATER exp
 	  	  {
-	  	  const Position * p = new Position($1->pos(), $3->pos());
-          $$ = new GreaterNode(p, $1, $3);
+		  $$ = build.binary(NodeKind::GREATER, build.span($1, $3), $1, $3);
 		  }
 		| exp GREATEREQ exp
 	  	  {
-	  	  const Position * p = new Position($1->pos(), $3->pos());
-          $$ = new GreaterEqNode(p, $1, $3);
+		  $$ = build.binary(NodeKind::GREATER_EQ, build.span($1, $3), $1, $3);
 		  }
 		| exp LESS exp
 	  	  {
-	  	  const Position * p = new Position($1->pos(), $3->pos());
-          $$ = new LessNode(p, $1, $3);
+		  $$ = build.binary(NodeKind::LESS, build.span($1, $3), $1, $3);
 		  }
 		| exp LESSEQ exp
 	  	  {
-	  	  const Position * p = new Position($1->pos(), $3->pos());
-          $$ = new LessEqNode(p, $1, $3);
+		  $$ = build.binary(NodeKind::LESS_EQ, build.span($1, $3), $1, $3);
 		  }
 		| NOT exp
 	  	  {
-	  	  const Position * p = new Position($1->pos(), $2->pos());
-          $$ = new NotNode(p, $2);
+	  	  Position p($1.pos(), &build.span($2));
+		  $$ = build.unary(NodeKind::NOT, p, $2);
 		  }
 		| DASH term
 	  	  {
-	  	  const Position * p = new Position($1->pos(), $2->pos());
-	  	  $$ = new NegNode(p, $2);
+	  	  Position p($1.pos(), &build.span($2));
+		  $$ = build.unary(NodeKind::NEG, p, $2);
 		  }
 		| term
 	  	  {
@@ -460,26 +454,24 @@ exp		: exp DASH exp
 
 callExp		: loc LPAREN RPAREN
 		  {
-		  const Position * p = new Position($1->pos(), $3->pos());
-		  std::list<ExpNode *> * emptyList = new std::list<ExpNode *>();
-		  $$ = new CallExpNode(p, $1, emptyList);
+		  Position p(&build.span($1), $3.pos());
+		  $$ = build.listed(NodeKind::CALL_EXP, p, $1, build.openList());
 		  }
 		| loc LPAREN actualsList RPAREN
 		  {
-		  const Position * p = new Position($1->pos(), $4->pos());
-          $$ = new CallExpNode(p, $1, $3);
+		  Position p(&build.span($1), $4.pos());
+		  $$ = build.listed(NodeKind::CALL_EXP, p, $1, $3);
 		  }
 
 actualsList	: exp
 		  {
-		  std::list<ExpNode *> * list = new std::list<ExpNode *>();
-		  list->push_back($1);
-		  $$ = list;
+		  $$ = build.openList();
+		  build.push($1);
 		  }
 		| actualsList COMMA exp
 		  {
 		  $$ = $1;
-		  $$->push_back($3);
+		  build.push($3);
 		  }
 
 term 		: loc
@@ -488,28 +480,24 @@ term 		: loc
 		  }
 		| INTLITERAL 
 		  {
-		  const Position * pos = $1->pos();
-          $$ = new IntLitNode(pos, $1->num());
+		  uint32_t bits = static_cast<uint32_t>($1.num());
+		  $$ = build.leaf(NodeKind::INT_LIT, *$1.pos(), bits);
 		  }
 		| STRINGLITERAL 
 		  {
-		  const Position * pos = $1->pos();
-          $$ = new StrLitNode(pos, $1->str());
+		  $$ = build.leaf(NodeKind::STR_LIT, *$1.pos(), $1.text());
 		  }
 		| TRUE
 		  {
-		  const Position * pos = $1->pos();
-          $$ = new TrueNode(pos);
+		  $$ = build.leaf(NodeKind::TRUE_LIT, *$1.pos());
 		  }
 		| FALSE
 		  {
-		  const Position * pos = $1->pos();
-		  $$ = new FalseNode(pos);
+		  $$ = build.leaf(NodeKind::FALSE_LIT, *$1.pos());
 		  }
 		| MAGIC
 		  {
-		  const Position * pos = $1->pos();
-		  $$ = new MagicNode(pos);
+		  $$ = build.leaf(NodeKind::MAGIC, *$1.pos());
 		  }
 		| LPAREN exp RPAREN
 		  {
@@ -526,20 +514,20 @@ loc		: id
 		  }
 		| loc POSTDEC id
 		  {
-		  const Position * p;
-          p = new Position($1->pos(), $3->pos());
-          $$ = new MemberFieldExpNode(p, $1, $3);
+		  Position p = build.span($1, $3);
+		  $$ = build.binary(NodeKind::MEMBER_FIELD, p, $1, $3);
 		  }
 
 id		: ID
 		  {
-		  const Position * pos = $1->pos();
-		  $$ = new IDNode(pos, $1->value());
+		  $$ = build.leaf(NodeKind::ID, *$1.pos(), $1.text());
 		  }
 	
 %%
 
 void drewno_mars::Parser::error(const std::string& msg){
-	std::cout << msg << std::endl;
-	std::cerr << "syntax error" << std::endl;
+	// Past the depth limit the parser only sees END, and the
+	// cutoff has been reported already
+	if (tokens.cutOff()){ return; }
+	diags.report(Severity::ERROR, DiagID::SYNTAX, tokens.lastSpan(), msg);
 }
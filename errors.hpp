@@ -6,8 +6,7 @@
 #define CODELOC __FILE__ ":" EXPAND1(__LINE__) " - "
 #define TODO(x) throw new ToDoError(CODELOC #x);
 
-#include <iostream>
-#include "position.hpp"
+#include <string>
 
 namespace drewno_mars{
 
@@ -45,29 +44,6 @@ private:
 	const char * myMsg;
 };
 
-/* This class is used to encapsulate error messages that the 
-   user of the compiler will see in cases where the spec wants 
-   a specific output format. */
-class Report{
-public:
-	static void fatal(
-		Position * pos,
-		const char * msg
-	){
-		std::cerr << "FATAL " 
-		<< pos->span()
-		<< ": " 
-		<< msg  << std::endl;
-	}
-
-	static void fatal(
-		Position * pos,
-		const std::string msg
-	){
-		fatal(pos,msg.c_str());
-	}
-};
-
 }
 
 #endif
@@ -0,0 +1,342 @@
+#include <climits>
+#include <cstring>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "fastscanner.hpp"
+
+namespace drewno_mars{
+
+using TokenKind = drewno_mars::Parser::token;
+using Lexeme = drewno_mars::Parser::semantic_type;
+
+/* Keywords that look like identifiers. The multi-word ones and
+   24Kmagic are matched separately, since no identifier spells
+   them. */
+struct Keyword{
+	const char * text;
+	size_t len;
+	int kind;
+};
+
+static constexpr Keyword KEYWORDS[] = {
+	{"and", 3, TokenKind::AND},
+	{"bool", 4, TokenKind::BOOL},
+	{"class", 5, TokenKind::CLASS},
+	{"else", 4, TokenKind::ELSE},
+	{"false", 5, TokenKind::FALSE},
+	{"give", 4, TokenKind::GIVE},
+	{"if", 2, TokenKind::IF},
+	{"int", 3, TokenKind::INT},
+	{"or", 2, TokenKind::OR},
+	{"perfect", 7, TokenKind::PERFECT},
+	{"return", 6, TokenKind::RETURN},
+	{"take", 4, TokenKind::TAKE},
+	{"true", 4, TokenKind::TRUE},
+	{"void", 4, TokenKind::VOID},
+	{"while", 5, TokenKind::WHILE},
+};
+static constexpr size_t NUM_KEYWORDS = sizeof(KEYWORDS) / sizeof(Keyword);
+static constexpr size_t KEYWORD_SLOTS = 32;
+
+/* Every keyword is at least two characters long, and these three
+   numbers are enough to tell them all apart */
+static constexpr size_t keywordHash(const char * text, size_t len){
+	return ((len << 2)
+	  + 3 * static_cast<unsigned char>(text[0])
+	  + 4 * static_cast<unsigned char>(text[1])) & (KEYWORD_SLOTS - 1);
+}
+
+struct KeywordTable{
+	/* Index into KEYWORDS, or -1 */
+	int slots[KEYWORD_SLOTS];
+};
+
+static constexpr KeywordTable buildKeywordTable(){
+	KeywordTable table{};
+	for (size_t i = 0; i < KEYWORD_SLOTS; i++){ table.slots[i] = -1; }
+	for (size_t k = 0; k < NUM_KEYWORDS; k++){
+		size_t h = keywordHash(KEYWORDS[k].text, KEYWORDS[k].len);
+		table.slots[h] = static_cast<int>(k);
+	}
+	return table;
+}
+
+static constexpr KeywordTable KEYWORD_TABLE = buildKeywordTable();
+
+static constexpr bool keywordHashIsPerfect(){
+	for (size_t k = 0; k < NUM_KEYWORDS; k++){
+		size_t h = keywordHash(KEYWORDS[k].text, KEYWORDS[k].len);
+		if (KEYWORD_TABLE.slots[h] != static_cast<int>(k)){
+			return false;
+		}
+	}
+	return true;
+}
+static_assert(keywordHashIsPerfect(),
+  "Two keywords share a slot; pick a new keywordHash");
+
+static const char MAGIC_TEXT[] = "24Kmagic";
+static const char TOO_HOT_REST[] = " hot";
+static const char NO_WORK_REST[] = " I don't feel like doing any work";
+
+static int keywordKind(const char * text, size_t len){
+	if (len < 2){ return TokenKind::ID; }
+	int k = KEYWORD_TABLE.slots[keywordHash(text, len)];
+	if (k < 0){ return TokenKind::ID; }
+	const Keyword& kw = KEYWORDS[k];
+	if (kw.len != len || memcmp(kw.text, text, len) != 0){
+		return TokenKind::ID;
+	}
+	return kw.kind;
+}
+
+static bool isIdentChar(char c){
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')
+	  || (c >= '0' && c <= '9') || c == '_';
+}
+
+static bool startsWith(const char * cur, const char * end,
+  const char * text, size_t len){
+	return static_cast<size_t>(end - cur) >= len
+	  && memcmp(cur, text, len) == 0;
+}
+
+/* Length of the run of spaces and tabs at p */
+static size_t blankRun(const char * p, const char * end){
+	const char * start = p;
+#ifdef __SSE2__
+	const __m128i space = _mm_set1_epi8(' ');
+	const __m128i tab = _mm_set1_epi8('\t');
+	while (end - p >= 16){
+		__m128i chunk = _mm_loadu_si128(
+		  reinterpret_cast<const __m128i *>(p));
+		__m128i blank = _mm_or_si128(
+		  _mm_cmpeq_epi8(chunk, space), _mm_cmpeq_epi8(chunk, tab));
+		unsigned int other =
+		  static_cast<unsigned int>(_mm_movemask_epi8(blank)) ^ 0xFFFFu;
+		if (other != 0){
+			return static_cast<size_t>(p - start)
+			  + static_cast<size_t>(__builtin_ctz(other));
+		}
+		p += 16;
+	}
+#endif
+	while (p < end && (*p == ' ' || *p == '\t')){ p++; }
+	return static_cast<size_t>(p - start);
+}
+
+/* Length of the text from p up to (not including) the next newline */
+static size_t lineRest(const char * p, const char * end){
+	const char * start = p;
+#ifdef __SSE2__
+	const __m128i newline = _mm_set1_epi8('\n');
+	while (end - p >= 16){
+		__m128i chunk = _mm_loadu_si128(
+		  reinterpret_cast<const __m128i *>(p));
+		unsigned int hits = static_cast<unsigned int>(
+		  _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline)));
+		if (hits != 0){
+			return static_cast<size_t>(p - start)
+			  + static_cast<size_t>(__builtin_ctz(hits));
+		}
+		p += 16;
+	}
+#endif
+	while (p < end && *p != '\n'){ p++; }
+	return static_cast<size_t>(p - start);
+}
+
+FastScanner::FastScanner(const SourceBuffer * src,
+  DiagnosticEngine * diagsIn)
+: FastScanner(src->data(), src->data() + src->size(), diagsIn){
+}
+
+FastScanner::FastScanner(const char * begin, const char * end,
+  DiagnosticEngine * diagsIn)
+: myDiags(diagsIn), myCur(begin), myEnd(end){
+}
+
+int FastScanner::token(Lexeme * lval, int kind, size_t len,
+  uint32_t payload){
+	Position pos(lineNum, colNum, lineNum, colNum + len);
+	lval->transToken = Token(pos, kind, payload);
+	colNum += len;
+	myCur += len;
+	return kind;
+}
+
+void FastScanner::error(DiagID id, size_t len, const char * arg){
+	Position pos(lineNum, colNum, lineNum, colNum + len);
+	myDiags->report(Severity::FATAL, id, pos, arg);
+	colNum += len;
+	myCur += len;
+}
+
+int FastScanner::scanToken(Lexeme * lval){
+	while (myCur < myEnd){
+		char c = *myCur;
+		char next = myCur + 1 < myEnd ? myCur[1] : '\0';
+		switch (c){
+		case ' ': case '\t': {
+			size_t len = blankRun(myCur, myEnd);
+			colNum += len;
+			myCur += len;
+			continue;
+		}
+		case '\n':
+			lineNum++;
+			colNum = 1;
+			myCur++;
+			continue;
+		case '\r':
+			if (next != '\n'){ break; }
+			lineNum++;
+			colNum = 1;
+			myCur += 2;
+			continue;
+		case '/':
+			if (next != '/'){ return token(lval, TokenKind::SLASH, 1); }
+			{
+				// The flex spec counts comment text toward the column
+				size_t len = lineRest(myCur, myEnd);
+				colNum += len;
+				myCur += len;
+			}
+			continue;
+		case '"': {
+			int kind = stringLiteral(lval);
+			if (kind != 0){ return kind; }
+			continue;
+		}
+		case '=':
+			if (next == '='){ return token(lval, TokenKind::EQUALS, 2); }
+			return token(lval, TokenKind::ASSIGN, 1);
+		case '>':
+			if (next == '='){ return token(lval, TokenKind::GREATEREQ, 2); }
+			return token(lval, TokenKind::GREATER, 1);
+		case '<':
+			if (next == '='){ return token(lval, TokenKind::LESSEQ, 2); }
+			return token(lval, TokenKind::LESS, 1);
+		case '!':
+			if (next == '='){ return token(lval, TokenKind::NOTEQUALS, 2); }
+			return token(lval, TokenKind::NOT, 1);
+		case '-':
+			if (next == '-'){ return token(lval, TokenKind::POSTDEC, 2); }
+			return token(lval, TokenKind::DASH, 1);
+		case '+':
+			if (next == '+'){ return token(lval, TokenKind::POSTINC, 2); }
+			return token(lval, TokenKind::CROSS, 1);
+		case ':': return token(lval, TokenKind::COLON, 1);
+		case ',': return token(lval, TokenKind::COMMA, 1);
+		case '{': return token(lval, TokenKind::LCURLY, 1);
+		case '}': return token(lval, TokenKind::RCURLY, 1);
+		case '(': return token(lval, TokenKind::LPAREN, 1);
+		case ')': return token(lval, TokenKind::RPAREN, 1);
+		case ';': return token(lval, TokenKind::SEMICOL, 1);
+		case '*': return token(lval, TokenKind::STAR, 1);
+		default:
+			if (c >= '0' && c <= '9'){ return intLiteral(lval); }
+			if (isIdentChar(c)){ return identifier(lval); }
+			break;
+		}
+		// Anything else (including a lone \r) is illegal. Like
+		// flex's yytext, a NUL byte prints as nothing.
+		char text[2] = {c, '\0'};
+		error(DiagID::ILLEGAL_CHAR, 1, text);
+	}
+	return TokenKind::END;
+}
+
+int FastScanner::identifier(Lexeme * lval){
+	const char * p = myCur + 1;
+	while (p < myEnd && isIdentChar(*p)){ p++; }
+	size_t len = static_cast<size_t>(p - myCur);
+
+	// The two phrases win over the shorter identifier they start with
+	if (len == 3 && memcmp(myCur, "too", 3) == 0
+	    && startsWith(p, myEnd, TOO_HOT_REST, sizeof(TOO_HOT_REST) - 1)){
+		return token(lval, TokenKind::FALSE,
+		  len + sizeof(TOO_HOT_REST) - 1);
+	}
+	if (len == 5 && memcmp(myCur, "today", 5) == 0
+	    && startsWith(p, myEnd, NO_WORK_REST, sizeof(NO_WORK_REST) - 1)){
+		return token(lval, TokenKind::EXIT,
+		  len + sizeof(NO_WORK_REST) - 1);
+	}
+
+	int kind = keywordKind(myCur, len);
+	if (kind != TokenKind::ID){ return token(lval, kind, len); }
+	StrHandle name = Interner::global().intern(myCur, len);
+	return token(lval, TokenKind::ID, len, name);
+}
+
+int FastScanner::intLiteral(Lexeme * lval){
+	if (startsWith(myCur, myEnd, MAGIC_TEXT, sizeof(MAGIC_TEXT) - 1)){
+		return token(lval, TokenKind::MAGIC, sizeof(MAGIC_TEXT) - 1);
+	}
+	const char * p = myCur;
+	while (p < myEnd && *p == '0'){ p++; }
+	const char * digits = p;
+	uint64_t value = 0;
+	while (p < myEnd && *p >= '0' && *p <= '9'){
+		// Past 10 significant digits it overflows anyway
+		if (p - digits < 11){
+			value = value * 10 + static_cast<uint64_t>(*p - '0');
+		}
+		p++;
+	}
+	size_t len = static_cast<size_t>(p - myCur);
+	bool overflow = p - digits > 10 || value > INT_MAX;
+	if (overflow){
+		Position pos(lineNum, colNum, lineNum, colNum + len);
+		myDiags->report(Severity::FATAL, DiagID::INT_OVERFLOW, pos);
+		value = 0;
+	}
+	return token(lval, TokenKind::INTLITERAL, len,
+	  static_cast<uint32_t>(value));
+}
+
+int FastScanner::stringLiteral(Lexeme * lval){
+	/* Consume escapes and plain characters up to the closing quote,
+	   a newline, the end, or a backslash that can't start any
+	   escape (one before a newline or the end) */
+	const char * p = myCur + 1;
+	bool badEscape = false;
+	bool closed = false;
+	while (p < myEnd){
+		char c = *p;
+		if (c == '"'){
+			closed = true;
+			break;
+		}
+		if (c == '\n'){ break; }
+		if (c == '\\'){
+			if (p + 1 == myEnd || p[1] == '\n'){ break; }
+			char escapee = p[1];
+			if (escapee != 'n' && escapee != 't'
+			    && escapee != '"' && escapee != '\\'){
+				badEscape = true;
+			}
+			p += 2;
+			continue;
+		}
+		p++;
+	}
+
+	size_t len = static_cast<size_t>(p - myCur) + (closed ? 1 : 0);
+	if (closed && !badEscape){
+		StrHandle text = Interner::global().intern(myCur, len);
+		return token(lval, TokenKind::STRINGLITERAL, len, text);
+	}
+	if (closed){
+		error(DiagID::STR_BAD_ESC, len);
+	} else if (badEscape){
+		error(DiagID::STR_BAD_ESC_UNTERM, len);
+	} else {
+		error(DiagID::STR_UNTERM, len);
+	}
+	return 0;
+}
+
+}
@@ -0,0 +1,309 @@
+#include "flatast.hpp"
+#include "astbuilder.hpp"
+#include "visitor.hpp"
+
+namespace drewno_mars{
+
+FlatAST::FlatAST(){
+	clear();
+}
+
+void FlatAST::clear(){
+	myKinds.clear();
+	mySpans.clear();
+	myData.clear();
+	myExtra.clear();
+	myPending.clear();
+	myRoot = 0;
+	// Index 0 is the "no node" slot
+	myKinds.push_back(NodeKind::PROGRAM);
+	mySpans.push_back(Position(0,0,0,0));
+	myData.push_back(Data{0, 0});
+}
+
+void FlatAST::reserve(size_t nodes){
+	myKinds.reserve(nodes + 1);
+	mySpans.reserve(nodes + 1);
+	myData.reserve(nodes + 1);
+}
+
+NodeIndex FlatAST::add(NodeKind kind, Position span,
+  uint32_t first, uint32_t second){
+	NodeIndex index = static_cast<NodeIndex>(myKinds.size());
+	myKinds.push_back(kind);
+	mySpans.push_back(span);
+	myData.push_back(Data{first, second});
+	return index;
+}
+
+uint32_t FlatAST::addExtra(uint32_t a, uint32_t b){
+	uint32_t index = static_cast<uint32_t>(myExtra.size());
+	myExtra.push_back(a);
+	myExtra.push_back(b);
+	return index;
+}
+
+uint32_t FlatAST::addExtra(uint32_t a, uint32_t b, uint32_t c){
+	uint32_t index = addExtra(a, b);
+	myExtra.push_back(c);
+	return index;
+}
+
+ListIndex FlatAST::closeList(uint32_t mark){
+	ListIndex index = static_cast<ListIndex>(myExtra.size());
+	myExtra.push_back(static_cast<uint32_t>(myPending.size() - mark));
+	myExtra.insert(myExtra.end(), myPending.begin() + mark,
+	  myPending.end());
+	myPending.resize(mark);
+	return index;
+}
+
+/**
+* \class Expander
+* Turns a FlatAST into linked nodes in one pass over its arrays,
+* handing each node to a PointerBuilder just as the parser would.
+* Since children come before their parents, each node's children
+* have already been built by the time it is reached.
+**/
+class Expander{
+public:
+	Expander(const FlatAST& tree, Arena& arena)
+	: myTree(tree), myBuilder(arena), myNodes(tree.size() + 1){ }
+
+	ProgramNode * run(){
+		for (NodeIndex i = 1; i < myNodes.size(); i++){
+			if (myTree.kind(i) == NodeKind::PROGRAM){
+				myBuilder.program(list(myTree.first(i)));
+			} else {
+				myNodes[i] = build(i);
+			}
+		}
+		return myBuilder.root();
+	}
+private:
+	/* Push a list's items, returning it for the builder to close */
+	ListRef list(ListIndex index){
+		ListRef result = myBuilder.openList();
+		const NodeIndex * end = myTree.listEnd(index);
+		for (const NodeIndex * it = myTree.listBegin(index); it != end; ++it){
+			myBuilder.push(myNodes[*it]);
+		}
+		return result;
+	}
+
+	NodeRef build(NodeIndex i){
+		NodeKind kind = myTree.kind(i);
+		const Position& pos = myTree.span(i);
+		uint32_t a = myTree.first(i);
+		uint32_t b = myTree.second(i);
+		switch (kind){
+		case NodeKind::VAR_DECL: {
+			NodeIndex init = myTree.extra(b + 1);
+			return myBuilder.varDecl(pos, myNodes[a],
+			  myNodes[myTree.extra(b)],
+			  init == 0 ? nullptr : &myNodes[init]);
+		}
+		case NodeKind::FN_DECL: {
+			ListRef formals = list(myTree.extra(b + 1));
+			ListRef body = list(myTree.extra(b + 2));
+			return myBuilder.fnDecl(pos, myNodes[a], formals,
+			  myNodes[myTree.extra(b)], body);
+		}
+		case NodeKind::IF_ELSE: {
+			ListRef yes = list(myTree.extra(b));
+			ListRef no = list(myTree.extra(b + 1));
+			return myBuilder.ifElse(pos, myNodes[a], yes, no);
+		}
+		case NodeKind::CLASS_DECL:
+		case NodeKind::IF:
+		case NodeKind::WHILE:
+		case NodeKind::CALL_EXP:
+			return myBuilder.listed(kind, pos, myNodes[a], list(b));
+		case NodeKind::RETURN:
+			if (a == 0){ return myBuilder.leaf(kind, pos, 0); }
+			return myBuilder.unary(kind, pos, myNodes[a]);
+		case NodeKind::CLASS_TYPE:
+		case NodeKind::PERFECT_TYPE:
+		case NodeKind::CALL_STMT:
+		case NodeKind::GIVE:
+		case NodeKind::POST_DEC:
+		case NodeKind::POST_INC:
+		case NodeKind::TAKE:
+		case NodeKind::NEG:
+		case NodeKind::NOT:
+			return myBuilder.unary(kind, pos, myNodes[a]);
+		case NodeKind::FORMAL_DECL:
+		case NodeKind::ASSIGN:
+		case NodeKind::MEMBER_FIELD:
+			return myBuilder.binary(kind, pos, myNodes[a], myNodes[b]);
+		default:
+			if (isBinaryExp(kind)){
+				return myBuilder.binary(kind, pos, myNodes[a], myNodes[b]);
+			}
+			return myBuilder.leaf(kind, pos, a);
+		}
+	}
+
+	const FlatAST& myTree;
+	PointerBuilder myBuilder;
+	std::vector<NodeRef> myNodes;
+};
+
+ProgramNode * expandAST(const FlatAST& tree, Arena& arena){
+	return Expander(tree, arena).run();
+}
+
+/**
+* \class Flattener
+* Appends a tree to a FlatAST, children first. Each visit comes once
+* a node's children are in and returns the node's index.
+**/
+class Flattener : public ASTFolder<Flattener, NodeIndex>{
+public:
+	explicit Flattener(FlatAST& tree) : myTree(tree){ }
+
+	template <typename T>
+	ListIndex addAll(const NodeList<T *> * list){
+		uint32_t mark = myTree.openList();
+		for (NodeIndex node : childList(list)){ myTree.push(node); }
+		return myTree.closeList(mark);
+	}
+
+	NodeIndex visitProgram(ProgramNode * node){
+		ListIndex globals = addAll(node->globals());
+		return myTree.add(NodeKind::PROGRAM, *node->pos(), globals);
+	}
+
+	NodeIndex visitVarDecl(VarDeclNode * node){
+		NodeIndex id = child(node->getID());
+		NodeIndex type = child(node->getType());
+		NodeIndex init = child(node->getExp());
+		return append(node, id, myTree.addExtra(type, init));
+	}
+
+	NodeIndex visitFormalDecl(FormalDeclNode * node){
+		NodeIndex id = child(node->getID());
+		NodeIndex type = child(node->getType());
+		return append(node, id, type);
+	}
+
+	NodeIndex visitFnDecl(FnDeclNode * node){
+		NodeIndex id = child(node->getID());
+		ListIndex formals = addAll(node->getDecls());
+		NodeIndex type = child(node->getType());
+		ListIndex body = addAll(node->getStmts());
+		return append(node, id, myTree.addExtra(type, formals, body));
+	}
+
+	NodeIndex visitClassDecl(ClassDeclNode * node){
+		NodeIndex id = child(node->getName());
+		return append(node, id, addAll(node->getDecls()));
+	}
+
+	NodeIndex visitClassType(ClassTypeNode * node){
+		return append(node, child(node->getID()));
+	}
+
+	NodeIndex visitPerfectType(PerfectTypeNode * node){
+		return append(node, child(node->getType()));
+	}
+
+	NodeIndex visitAssign(AssignStmtNode * node){
+		NodeIndex dest = child(node->getDest());
+		NodeIndex exp = child(node->getExp());
+		return append(node, dest, exp);
+	}
+
+	NodeIndex visitCallStmt(CallStmtNode * node){
+		return append(node, child(node->getCall()));
+	}
+
+	NodeIndex visitGive(GiveStmtNode * node){
+		return append(node, child(node->getExp()));
+	}
+
+	NodeIndex visitReturn(ReturnStmtNode * node){
+		return append(node, child(node->getExp()));
+	}
+
+	NodeIndex visitIfElse(IfElseStmtNode * node){
+		NodeIndex cond = child(node->getCondition());
+		ListIndex yes = addAll(node->getTrueBranch());
+		ListIndex no = addAll(node->getFalseBranch());
+		return append(node, cond, myTree.addExtra(yes, no));
+	}
+
+	NodeIndex visitIf(IfStmtNode * node){
+		NodeIndex cond = child(node->getCondition());
+		return append(node, cond, addAll(node->getStmts()));
+	}
+
+	NodeIndex visitWhile(WhileStmtNode * node){
+		NodeIndex cond = child(node->getExp());
+		return append(node, cond, addAll(node->getStmts()));
+	}
+
+	NodeIndex visitPostDec(PostDecStmtNode * node){
+		return append(node, child(node->getLoc()));
+	}
+
+	NodeIndex visitPostInc(PostIncStmtNode * node){
+		return append(node, child(node->getLoc()));
+	}
+
+	NodeIndex visitTake(TakeStmtNode * node){
+		return append(node, child(node->getLoc()));
+	}
+
+	NodeIndex visitCallExp(CallExpNode * node){
+		NodeIndex name = child(node->getFunctionName());
+		return append(node, name, addAll(node->getArgs()));
+	}
+
+	NodeIndex visitMemberField(MemberFieldExpNode * node){
+		NodeIndex loc = child(node->getLoc());
+		NodeIndex name = child(node->getName());
+		return append(node, loc, name);
+	}
+
+	NodeIndex visitID(IDNode * node){
+		return append(node, node->getName());
+	}
+
+	NodeIndex visitStrLit(StrLitNode * node){
+		return append(node, node->getStr());
+	}
+
+	NodeIndex visitIntLit(IntLitNode * node){
+		return append(node, static_cast<uint32_t>(node->getValue()));
+	}
+
+	NodeIndex visitUnaryExp(UnaryExpNode * node){
+		return append(node, child(node->getExp()));
+	}
+
+	NodeIndex visitBinaryExp(BinaryExpNode * node){
+		NodeIndex lhs = child(node->getLhs());
+		NodeIndex rhs = child(node->getRhs());
+		return append(node, lhs, rhs);
+	}
+
+	/* Types, exit, and the constants have no data */
+	NodeIndex visitNode(ASTNode * node){
+		return append(node);
+	}
+private:
+	/* Add node itself, once its children are in */
+	NodeIndex append(ASTNode * node, uint32_t a = 0, uint32_t b = 0){
+		return myTree.add(node->kind(), *node->pos(), a, b);
+	}
+
+	FlatAST& myTree;
+};
+
+void flattenAST(ProgramNode * root, FlatAST& tree){
+	tree.clear();
+	tree.setRoot(Flattener(tree).fold(root));
+}
+
+}
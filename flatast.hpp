@@ -0,0 +1,202 @@
+#ifndef DREWNO_MARS_FLATAST_H
+#define DREWNO_MARS_FLATAST_H
+
+#include <cstdint>
+#include <vector>
+#include "arena.hpp"
+#include "ast.hpp"
+#include "position.hpp"
+
+namespace drewno_mars{
+
+/* A node of a FlatAST, as its place in the node arrays. Index 0 is
+   never a node, so it stands for "no node" (a missing initializer
+   or return value). */
+using NodeIndex = uint32_t;
+
+/* A list of children in a FlatAST's extra data: the count at
+   extra(list), then that many NodeIndex values */
+using ListIndex = uint32_t;
+
+/**
+* \class FlatAST
+* The AST as parallel arrays instead of linked objects: one kind, one
+* span and two 32-bit data words per node, plus an array of extra
+* words for lists and for nodes with more than two children. Nodes
+* are numbered in the order the parser reduces them, which is
+* post-order, so a node's children always come before it and the
+* root is the last node. Nothing in it is a pointer, so a tree can
+* be copied, moved or written out as its arrays.
+*
+* The data words of each kind are
+*
+*     PROGRAM                       globals list
+*     VAR_DECL                      id, extra e: type, init (or 0)
+*     FORMAL_DECL                   id, type
+*     FN_DECL                       id, extra e: type, formals list,
+*                                     body list
+*     CLASS_DECL                    id, members list
+*     CLASS_TYPE, PERFECT_TYPE      the named or wrapped type
+*     ASSIGN                        destination, value
+*     CALL_STMT                     the call
+*     GIVE, RETURN, NEG, NOT        the operand (RETURN's may be 0)
+*     POST_DEC, POST_INC, TAKE      the location
+*     IF, WHILE                     condition, body list
+*     IF_ELSE                       condition, extra e: true list,
+*                                     false list
+*     CALL_EXP                      callee, arguments list
+*     MEMBER_FIELD                  location, field id
+*     binary operators              lhs, rhs
+*     INT_LIT                       the value's bits
+*     ID, STR_LIT                   the interned text's handle
+*
+* and unused words are 0.
+**/
+class FlatAST{
+public:
+	FlatAST();
+
+	NodeKind kind(NodeIndex node) const { return myKinds[node]; }
+	const Position& span(NodeIndex node) const { return mySpans[node]; }
+	uint32_t first(NodeIndex node) const { return myData[node].first; }
+	uint32_t second(NodeIndex node) const { return myData[node].second; }
+	uint32_t extra(uint32_t index) const { return myExtra[index]; }
+
+	/** The children in a list, as a range of NodeIndex values **/
+	const NodeIndex * listBegin(ListIndex list) const {
+		return myExtra.data() + list + 1;
+	}
+	const NodeIndex * listEnd(ListIndex list) const {
+		return listBegin(list) + myExtra[list];
+	}
+
+	/** The PROGRAM node, or 0 if no tree has been finished **/
+	NodeIndex root() const { return myRoot; }
+	/** Number of nodes, not counting the unused index 0 **/
+	size_t size() const { return myKinds.size() - 1; }
+
+	/* Building, as a FlatBuilder does while the parser reduces */
+
+	/** Append a node whose children (if any) are already added **/
+	NodeIndex add(NodeKind kind, Position span,
+	  uint32_t first = 0, uint32_t second = 0);
+	/** Store words in the extra data, returning the first's index **/
+	uint32_t addExtra(uint32_t a, uint32_t b);
+	uint32_t addExtra(uint32_t a, uint32_t b, uint32_t c);
+
+	/** Lists are collected on a stack: open one, push its items,
+	    and close it to copy them into the extra data. Lists nest,
+	    and a list must be closed before any list opened under it
+	    is. **/
+	uint32_t openList() const {
+		return static_cast<uint32_t>(myPending.size());
+	}
+	void push(NodeIndex item){ myPending.push_back(item); }
+	ListIndex closeList(uint32_t mark);
+	/** Forget a list that will never be closed, along with
+	    anything pushed since it was opened **/
+	void dropList(uint32_t mark){
+		if (mark < myPending.size()){ myPending.resize(mark); }
+	}
+
+	void setRoot(NodeIndex root){ myRoot = root; }
+
+	/** Make room for nodes nodes without growing the arrays **/
+	void reserve(size_t nodes);
+
+	/** Forget every node, keeping the arrays' capacity **/
+	void clear();
+private:
+	struct Data{
+		uint32_t first;
+		uint32_t second;
+	};
+
+	std::vector<NodeKind> myKinds;
+	std::vector<Position> mySpans;
+	std::vector<Data> myData;
+	std::vector<uint32_t> myExtra;
+	std::vector<NodeIndex> myPending;
+	NodeIndex myRoot = 0;
+};
+
+/**
+* Call f(child) on each child of node that is present, in source
+* order, like forEachChild on the pointer tree.
+**/
+template <typename F>
+void forEachChild(const FlatAST& tree, NodeIndex node, F f){
+	auto each = [&](ListIndex list){
+		for (auto it = tree.listBegin(list); it != tree.listEnd(list); ++it){
+			f(*it);
+		}
+	};
+	auto one = [&](NodeIndex child){
+		if (child != 0){ f(child); }
+	};
+	uint32_t a = tree.first(node);
+	uint32_t b = tree.second(node);
+	switch (tree.kind(node)){
+	case NodeKind::PROGRAM:
+		each(a);
+		break;
+	case NodeKind::VAR_DECL:
+		f(a);
+		f(tree.extra(b));
+		one(tree.extra(b + 1));
+		break;
+	case NodeKind::FN_DECL:
+		f(a);
+		each(tree.extra(b + 1));
+		f(tree.extra(b));
+		each(tree.extra(b + 2));
+		break;
+	case NodeKind::IF_ELSE:
+		f(a);
+		each(tree.extra(b));
+		each(tree.extra(b + 1));
+		break;
+	case NodeKind::CLASS_DECL:
+	case NodeKind::IF:
+	case NodeKind::WHILE:
+	case NodeKind::CALL_EXP:
+		f(a);
+		each(b);
+		break;
+	case NodeKind::CLASS_TYPE:
+	case NodeKind::PERFECT_TYPE:
+	case NodeKind::CALL_STMT:
+	case NodeKind::GIVE:
+	case NodeKind::RETURN:
+	case NodeKind::NEG:
+	case NodeKind::NOT:
+	case NodeKind::POST_DEC:
+	case NodeKind::POST_INC:
+	case NodeKind::TAKE:
+		one(a);
+		break;
+	case NodeKind::FORMAL_DECL:
+	case NodeKind::ASSIGN:
+	case NodeKind::MEMBER_FIELD:
+		f(a);
+		f(b);
+		break;
+	default:
+		if (isBinaryExp(tree.kind(node))){
+			f(a);
+			f(b);
+		}
+		break;
+	}
+}
+
+/** Build the pointer tree for a finished FlatAST, with its nodes
+    and positions in arena **/
+ProgramNode * expandAST(const FlatAST& tree, Arena& arena);
+
+/** Replace the contents of tree with the tree rooted at root **/
+void flattenAST(ProgramNode * root, FlatAST& tree);
+
+}
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef DREWNO_MARS_HASH_H
+#define DREWNO_MARS_HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace drewno_mars{
+
+/* A 64-bit hash of a whole file's contents, used to tell whether a
+   file really changed. It is FNV-1a taken a word at a time, with 
+   an extra shift so the high bits of each word reach the low ones.
+   Fast, but not meant to stand up to deliberate collisions. */
+inline uint64_t contentHash(const char * data, size_t len){
+	const uint64_t prime = 1099511628211ull;
+	uint64_t h = 14695981039346656037ull ^ len;
+	size_t i = 0;
+	for (; i + 8 <= len; i += 8){
+		uint64_t word;
+		std::memcpy(&word, data + i, sizeof(word));
+		h = (h ^ word) * prime;
+		h ^= h >> 29;
+	}
+	for (; i < len; i++){
+		h = (h ^ static_cast<unsigned char>(data[i])) * prime;
+	}
+	return h;
+}
+
+}
+
+#endif
@@ -0,0 +1,346 @@
+#include <algorithm>
+#include <cstring>
+#include "incremental.hpp"
+#include "fastscanner.hpp"
+#include "astbuilder.hpp"
+#include "errors.hpp"
+
+namespace drewno_mars{
+
+using TokenKind = drewno_mars::Parser::token;
+
+struct IncrementalSession::Chunk{
+	/* The chunk's text, and the newlines in it */
+	std::string text;
+	size_t lines = 0;
+	/* The chunk's first byte in the whole text, and the program's
+	   declarations before it; see IncrementalSession::index */
+	size_t start = 0;
+	size_t declsBefore = 0;
+	/* Tokens with lines counted from the chunk's first line, and
+	   an END token so the parser can read them on their own */
+	TokenBuffer tokens;
+	DiagnosticEngine lexDiags;
+	/* Declarations are small; don't reserve a big block for each */
+	Arena arena{4 * 1024};
+	/* Only a chunk without syntax errors gets one */
+	ProgramNode * ast = nullptr;
+
+	size_t end() const { return start + text.size(); }
+	size_t decls() const {
+		return ast == nullptr ? 0 : ast->globals()->size();
+	}
+
+	int firstKind() const { return tokens.kind(0); }
+	int lastKind() const {
+		size_t count = tokens.size() - 1;
+		return count == 0 ? static_cast<int>(TokenKind::END)
+		  : tokens.kind(count - 1);
+	}
+};
+
+static Position shifted(const Position& pos, size_t lineShift){
+	if (pos.lineBegin() == 0){ return pos; } // No position at all
+	return Position(pos.lineBegin() + lineShift, pos.colBegin(),
+	  pos.lineEnd() + lineShift, pos.colEnd());
+}
+
+/* pos, with lines counted from line shift + 1 instead of line 1 */
+static Position rebased(const Position& pos, size_t shift){
+	return Position(pos.lineBegin() - shift, pos.colBegin(),
+	  pos.lineEnd() - shift, pos.colEnd());
+}
+
+static void copyDiagnostics(const DiagnosticEngine& from,
+  DiagnosticEngine& to, size_t lineShift){
+	for (const Diagnostic& diag : from.diagnostics()){
+		to.report(diag.severity, diag.id,
+		  shifted(diag.span, lineShift), from.arg(diag));
+	}
+}
+
+IncrementalSession::IncrementalSession(const char * text, size_t size,
+  size_t depthLimit)
+: mySize(size), myDepthLimit(depthLimit){
+	myGlobals = myProgramArena.make<NodeList<DeclNode *>>(myProgramArena);
+	// The span is left empty: each chunk counts its own lines
+	myProgram = myProgramArena.make<ProgramNode>(myGlobals);
+	rebuild(0, 0, std::string(text, size));
+}
+
+IncrementalSession::~IncrementalSession(){ }
+
+void IncrementalSession::edit(size_t offset, size_t removed,
+  const std::string& inserted){
+	if (offset > mySize || removed > mySize - offset){
+		throw new UserError("Edit is outside the text");
+	}
+
+	/* The chunks holding the first edited byte and the byte just
+	   past the edit, since the edit may join that line to ours */
+	size_t first = locate(offset);
+	size_t last = locate(offset + removed);
+	/* A class body's closing brace is followed by a semicolon that
+	   the edit could have moved, so take the chunk before along */
+	if (first > 0 && myChunks[first - 1]->lastKind() == TokenKind::RCURLY){
+		first--;
+	}
+
+	std::string region;
+	for (size_t i = first; i <= last; i++){ region += myChunks[i]->text; }
+	region.replace(offset - myChunks[first]->start, removed, inserted);
+	mySize = mySize - removed + inserted.size();
+	rebuild(first, last + 1, std::move(region));
+}
+
+std::string IncrementalSession::text() const{
+	std::string result;
+	result.reserve(mySize);
+	for (const auto& chunk : myChunks){ result += chunk->text; }
+	return result;
+}
+
+size_t IncrementalSession::locate(size_t offset){
+	auto begin = myChunks.begin();
+	if (myIndexed > 0 && offset < myChunks[myIndexed - 1]->end()){
+		auto found = std::upper_bound(begin,
+		  begin + static_cast<std::ptrdiff_t>(myIndexed), offset,
+		  [](size_t off, const std::unique_ptr<Chunk>& chunk){
+			return off < chunk->end();
+		});
+		return static_cast<size_t>(found - begin);
+	}
+	/* Past the indexed chunks, index more until offset is reached */
+	for (size_t i = myIndexed; i < myChunks.size(); i++){
+		index(i);
+		if (offset < myChunks[i]->end()){ return i; }
+	}
+	return myChunks.size() - 1;
+}
+
+void IncrementalSession::index(size_t i){
+	for (; myIndexed <= i; myIndexed++){
+		Chunk& chunk = *myChunks[myIndexed];
+		if (myIndexed == 0){
+			chunk.start = 0;
+			chunk.declsBefore = 0;
+		} else {
+			const Chunk& prev = *myChunks[myIndexed - 1];
+			chunk.start = prev.end();
+			chunk.declsBefore = prev.declsBefore + prev.decls();
+		}
+	}
+}
+
+/* Find the lines that end a chunk: those whose last token is a
+   top-level ';' or a function's closing '}' (a class's '}' is 
+   followed by its ';'). nextKind is the kind of the first token 
+   after the region. Returns true if the region's last token is
+   such an end. */
+static bool chunkEnds(const TokenBuffer& tokens, int nextKind,
+  std::vector<size_t>& ends){
+	size_t count = tokens.size() - 1; // Not END
+	size_t depth = 0;
+	bool ended = false;
+	for (size_t i = 0; i < count; i++){
+		int kind = tokens.kind(i);
+		if (kind == TokenKind::LCURLY){ depth++; }
+		if (kind == TokenKind::RCURLY && depth > 0){ depth--; }
+		size_t line = tokens.span(i).lineBegin();
+		bool lastOnLine = i + 1 == count
+		  || tokens.span(i + 1).lineBegin() > line;
+		ended = false;
+		if (!lastOnLine || depth != 0){ continue; }
+		int following = i + 1 < count ? tokens.kind(i + 1) : nextKind;
+		if (kind == TokenKind::SEMICOL
+		    || (kind == TokenKind::RCURLY 
+		        && following != TokenKind::SEMICOL)){
+			ends.push_back(line);
+			ended = true;
+		}
+	}
+	return ended;
+}
+
+void IncrementalSession::rebuild(size_t first, size_t last,
+  std::string region){
+	TokenBuffer tokens;
+	std::unique_ptr<DiagnosticEngine> lexDiags;
+	std::vector<size_t> ends;
+	bool ended = false;
+	myLastScanned = 0;
+	for (;;){
+		tokens.clear();
+		lexDiags.reset(new DiagnosticEngine());
+		ends.clear();
+		const char * text = region.data();
+		FastScanner(text, text + region.size(), lexDiags.get()).fill(tokens);
+		myLastScanned += region.size();
+
+		bool atEnd = last == myChunks.size();
+		int nextKind = atEnd ? static_cast<int>(TokenKind::END)
+		  : myChunks[last]->firstKind();
+		ended = chunkEnds(tokens, nextKind, ends);
+		if (ended || atEnd){ break; }
+		region += myChunks[last]->text;
+		last++;
+	}
+	const char * text = region.data();
+	size_t len = region.size();
+
+	/* Where each line of the region starts. Line lineCount + 1 is
+	   whatever follows the last newline, possibly nothing. */
+	std::vector<size_t> lineStarts(2, 0);
+	for (const char * p = text; ; p++){
+		p = static_cast<const char *>(
+		  memchr(p, '\n', static_cast<size_t>(text + len - p)));
+		if (p == nullptr){ break; }
+		lineStarts.push_back(static_cast<size_t>(p - text) + 1);
+	}
+	size_t lineCount = lineStarts.size() - 2;
+	/* Trailing lines without tokens join the last chunk */
+	if (ended){ ends.back() = lineCount + 1; }
+	else { ends.push_back(lineCount + 1); }
+
+	std::vector<std::unique_ptr<Chunk>> fresh;
+	size_t count = tokens.size() - 1;
+	size_t tok = 0;
+	const std::vector<Diagnostic>& lexList = lexDiags->diagnostics();
+	size_t diag = 0;
+	size_t from = 1;
+	for (size_t to : ends){
+		bool final = to == lineCount + 1;
+		size_t shift = from - 1;
+		std::unique_ptr<Chunk> chunk(new Chunk());
+		chunk->text.assign(region, lineStarts[from],
+		  (final ? len : lineStarts[to + 1]) - lineStarts[from]);
+		chunk->lines = final ? to - from : to - from + 1;
+
+		for (; tok < count && tokens.span(tok).lineBegin() <= to; tok++){
+			chunk->tokens.push(Token(rebased(tokens.span(tok), shift),
+			  tokens.kind(tok), tokens.payload(tok)));
+		}
+		if (final){
+			chunk->tokens.push(Token(rebased(tokens.span(count), shift),
+			  TokenKind::END));
+		} else {
+			size_t line = chunk->lines + 1;
+			chunk->tokens.push(Token(Position(line, 1, line, 1),
+			  TokenKind::END));
+		}
+		for (; diag < lexList.size() 
+		    && lexList[diag].span.lineBegin() <= to; diag++){
+			const Diagnostic& d = lexList[diag];
+			chunk->lexDiags.report(d.severity, d.id, 
+			  rebased(d.span, shift), lexDiags->arg(d));
+		}
+
+		TokenBufferReader reader(chunk->tokens);
+		reader.setDepthLimit(myDepthLimit);
+		PointerBuilder builder(chunk->arena);
+		// Only whether it parsed is kept; see syntaxErrors()
+		DiagnosticEngine parseDiags;
+		Parser parser(reader, builder, parseDiags);
+		if (parser.parse() == 0 && parseDiags.count(Severity::ERROR) == 0){
+			chunk->ast = builder.root();
+		}
+
+		fresh.push_back(std::move(chunk));
+		from = to + 1;
+	}
+
+	/* Splice the fresh chunks' declarations into the program in
+	   place of the old chunks' */
+	size_t declsAt = 0;
+	if (first < myChunks.size()){
+		index(first);
+		declsAt = myChunks[first]->declsBefore;
+	}
+	size_t removed = 0;
+	for (size_t i = first; i < last; i++){
+		removed += myChunks[i]->decls();
+		if (myChunks[i]->ast == nullptr){ myFailed--; }
+	}
+	std::vector<DeclNode *> added;
+	for (const auto& chunk : fresh){
+		if (chunk->ast == nullptr){
+			myFailed++;
+			continue;
+		}
+		for (DeclNode * decl : *chunk->ast->globals()){
+			added.push_back(decl);
+		}
+	}
+	myGlobals->replace(declsAt, removed, added.data(), added.size());
+
+	/* Most edits leave as many chunks as there were, and then the
+	   chunks after them don't have to move at all */
+	size_t kept = std::min(last - first, fresh.size());
+	for (size_t i = 0; i < kept; i++){
+		myChunks[first + i] = std::move(fresh[i]);
+	}
+	auto at = myChunks.begin() + static_cast<std::ptrdiff_t>(first + kept);
+	if (fresh.size() > kept){
+		auto rest = fresh.begin() + static_cast<std::ptrdiff_t>(kept);
+		myChunks.insert(at, std::make_move_iterator(rest),
+		  std::make_move_iterator(fresh.end()));
+	} else {
+		myChunks.erase(at, myChunks.begin() + static_cast<std::ptrdiff_t>(last));
+	}
+	/* The chunks after the fresh ones have moved */
+	myIndexed = std::min(myIndexed, first);
+	index(first + fresh.size() - 1);
+	mySyntaxErrors.reset();
+}
+
+const DiagnosticEngine& IncrementalSession::syntaxErrors(){
+	if (mySyntaxErrors != nullptr){ return *mySyntaxErrors; }
+	mySyntaxErrors.reset(new DiagnosticEngine());
+	if (myFailed == 0){ return *mySyntaxErrors; }
+
+	TokenBuffer rest;
+	size_t shift = 0;
+	bool failing = false;
+	for (const auto& chunk : myChunks){
+		failing = failing || chunk->ast == nullptr;
+		if (failing){
+			const TokenBuffer& tokens = chunk->tokens;
+			size_t count = tokens.size() - 1;
+			if (&chunk == &myChunks.back()){ count++; } // The real END
+			for (size_t i = 0; i < count; i++){
+				rest.push(Token(shifted(tokens.span(i), shift),
+				  tokens.kind(i), tokens.payload(i)));
+			}
+		}
+		shift += chunk->lines;
+	}
+	TokenBufferReader reader(rest);
+	reader.setDepthLimit(myDepthLimit);
+	Arena arena;
+	PointerBuilder builder(arena);
+	Parser parser(reader, builder, *mySyntaxErrors);
+	parser.parse();
+	return *mySyntaxErrors;
+}
+
+void IncrementalSession::writeTokens(Writer& out) const{
+	size_t shift = 0;
+	for (const auto& chunk : myChunks){
+		const TokenBuffer& tokens = chunk->tokens;
+		size_t count = tokens.size() - 1;
+		if (&chunk == &myChunks.back()){ count++; } // The real END
+		tokens.write(out, 0, count, shift);
+		shift += chunk->lines;
+	}
+}
+
+void IncrementalSession::report(DiagnosticEngine& diags){
+	size_t shift = 0;
+	for (const auto& chunk : myChunks){
+		copyDiagnostics(chunk->lexDiags, diags, shift);
+		shift += chunk->lines;
+	}
+	copyDiagnostics(syntaxErrors(), diags, 0);
+}
+
+}
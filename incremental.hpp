@@ -0,0 +1,108 @@
+#ifndef DREWNO_MARS_INCREMENTAL_H
+#define DREWNO_MARS_INCREMENTAL_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "arena.hpp"
+#include "ast.hpp"
+#include "diagnostics.hpp"
+#include "tokenbuffer.hpp"
+#include "writer.hpp"
+
+namespace drewno_mars{
+
+/**
+* \class IncrementalSession
+* Keeps one source text scanned and parsed across a series of edits,
+* for editors that re-check after every keystroke.
+*
+* The text is split into chunks of whole lines, each holding one or
+* more complete top-level declarations. A chunk keeps its own text,
+* tokens, lexical errors and AST, all with line numbers counted from
+* the chunk's first line, in its own arena. No token spans a line, so
+* an edit only has to re-scan and re-parse the chunks whose lines it
+* touches. The rest of the file is left alone even when the edit adds
+* or removes lines: the chunks are found by a binary search over
+* their starting offsets, which are brought up to date lazily, and
+* the program's list of declarations is spliced rather than rebuilt.
+*
+* An edited region grows into the next chunk only while it does not
+* end on a declaration boundary, e.g. right after typing a '{'.
+*
+* Up to the first chunk with a syntax error, the chunks parse just as
+* the whole text would. From there on the parser's error recovery
+* can run across chunk boundaries, so the syntax errors are found by
+* parsing everything from that chunk to the end as one, once they are
+* asked for. They then match a full compile's, at the cost of that
+* parse while the text has an error.
+**/
+class IncrementalSession{
+public:
+	/** Chunks are parsed with the given limit on the parser's
+	    depth, as Compilation::setDepthLimit **/
+	IncrementalSession(const char * text, size_t size,
+	  size_t depthLimit = DEFAULT_DEPTH_LIMIT);
+	~IncrementalSession();
+	IncrementalSession(const IncrementalSession&) = delete;
+	IncrementalSession& operator=(const IncrementalSession&) = delete;
+
+	/** Replace the removed bytes at offset with inserted. Throws a
+	    UserError if the range is not inside the text **/
+	void edit(size_t offset, size_t removed, const std::string& inserted);
+
+	/** The current text, put together from the chunks **/
+	std::string text() const;
+
+	/** True if every chunk parsed without a syntax error **/
+	bool parsed() const { return myFailed == 0; }
+	/** The whole program, made of the chunks' declarations, or
+	    nullptr if any chunk failed to parse. Its positions are
+	    counted from each declaration's chunk. Valid until the next
+	    edit. **/
+	ProgramNode * program(){ return parsed() ? myProgram : nullptr; }
+
+	/** Write the token stream in the -t format, as a full scan of
+	    the current text would **/
+	void writeTokens(Writer& out) const;
+	/** Add the diagnostics for the current text to diags: lexical
+	    errors first, then the syntax errors, as a full compile with
+	    the tokens buffered would report them **/
+	void report(DiagnosticEngine& diags);
+
+	size_t chunkCount() const { return myChunks.size(); }
+	/** Bytes scanned by the last edit (or the initial load) **/
+	size_t lastScanned() const { return myLastScanned; }
+private:
+	struct Chunk;
+
+	/* Scan and parse region, the new text of chunks [first, last),
+	   growing it while it doesn't end on a boundary, and swap in
+	   the chunks that result */
+	void rebuild(size_t first, size_t last, std::string region);
+	/* The chunk holding the byte at offset, or the last chunk if
+	   offset is the end of the text */
+	size_t locate(size_t offset);
+	/* Bring the starts of the chunks through i up to date */
+	void index(size_t i);
+	/* The syntax errors, parsed again from the first failing chunk
+	   on if they aren't known since the last edit */
+	const DiagnosticEngine& syntaxErrors();
+
+	std::vector<std::unique_ptr<Chunk>> myChunks;
+	/* The leading chunks whose starts are up to date */
+	size_t myIndexed = 0;
+	size_t mySize = 0;
+	/* Chunks that failed to parse */
+	size_t myFailed = 0;
+	Arena myProgramArena;
+	NodeList<DeclNode *> * myGlobals;
+	ProgramNode * myProgram;
+	std::unique_ptr<DiagnosticEngine> mySyntaxErrors;
+	size_t myLastScanned = 0;
+	size_t myDepthLimit;
+};
+
+}
+
+#endif
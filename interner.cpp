@@ -0,0 +1,144 @@
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include "interner.hpp"
+
+namespace drewno_mars{
+
+static const size_t CHUNK_SIZE = 64 * 1024;
+
+const size_t Interner::BLOCK_BITS;
+const size_t Interner::BLOCK_SIZE;
+const size_t Interner::MAX_BLOCKS;
+
+Interner& Interner::global(){
+	static Interner table;
+	return table;
+}
+
+Interner::Table::Table(size_t size)
+: mask(size - 1), slots(new std::atomic<StrHandle>[size]){
+	for (size_t i = 0; i < size; i++){ slots[i].store(0); }
+}
+
+Interner::Interner() : myBlocks(MAX_BLOCKS, nullptr){
+	myTables.emplace_back(new Table(1024));
+	myTableBytes = 1024 * sizeof(StrHandle);
+	myTable.store(myTables.back().get());
+}
+
+Interner::~Interner(){
+	for (auto chunk : myChunks){ std::free(chunk); }
+	for (auto block : myBlocks){ delete[] block; }
+}
+
+size_t Interner::size() const{
+	std::lock_guard<std::mutex> guard(myLock);
+	return myCount;
+}
+
+size_t Interner::bytes() const{
+	std::lock_guard<std::mutex> guard(myLock);
+	size_t blocks = (myCount + BLOCK_SIZE - 1) >> BLOCK_BITS;
+	return myChunkBytes + blocks * BLOCK_SIZE * sizeof(Entry)
+	  + myTableBytes;
+}
+
+uint32_t Interner::hash(const char * text, size_t len){
+	// FNV-1a
+	uint32_t h = 2166136261u;
+	for (size_t i = 0; i < len; i++){
+		h ^= static_cast<unsigned char>(text[i]);
+		h *= 16777619u;
+	}
+	return h;
+}
+
+const char * Interner::store(const char * text, size_t len){
+	size_t need = len + 1;
+	char * dest;
+	if (need > CHUNK_SIZE / 4){
+		// Long strings get a chunk of their own
+		dest = static_cast<char *>(std::malloc(need));
+		if (dest == nullptr){ throw std::bad_alloc(); }
+		myChunks.push_back(dest);
+		myChunkBytes += need;
+	} else {
+		if (need > myLeft){
+			myCur = static_cast<char *>(std::malloc(CHUNK_SIZE));
+			if (myCur == nullptr){ throw std::bad_alloc(); }
+			myChunks.push_back(myCur);
+			myChunkBytes += CHUNK_SIZE;
+			myLeft = CHUNK_SIZE;
+		}
+		dest = myCur;
+		myCur += need;
+		myLeft -= need;
+	}
+	std::memcpy(dest, text, len);
+	dest[len] = '\0';
+	return dest;
+}
+
+void Interner::grow(){
+	size_t size = (myTable.load(std::memory_order_relaxed)->mask + 1) * 2;
+	std::unique_ptr<Table> table(new Table(size));
+	for (StrHandle h = 1; h <= myCount; h++){
+		size_t i = entry(h).hash & table->mask;
+		while (table->slots[i].load(std::memory_order_relaxed) != 0){
+			i = (i + 1) & table->mask;
+		}
+		table->slots[i].store(h, std::memory_order_relaxed);
+	}
+	myTableBytes += size * sizeof(StrHandle);
+	myTable.store(table.get(), std::memory_order_release);
+	myTables.push_back(std::move(table));
+}
+
+StrHandle Interner::find(const Table& table, const char * text,
+  size_t len, uint32_t h, size_t& i) const{
+	i = h & table.mask;
+	for (;;){
+		StrHandle found = table.slots[i].load(std::memory_order_acquire);
+		if (found == 0){ return 0; }
+		const Entry& e = entry(found);
+		if (e.hash == h && e.len == len 
+		    && std::memcmp(e.chars, text, len) == 0){
+			return found;
+		}
+		i = (i + 1) & table.mask;
+	}
+}
+
+StrHandle Interner::intern(const char * text, size_t len){
+	uint32_t h = hash(text, len);
+	size_t i;
+	StrHandle found = find(*myTable.load(std::memory_order_acquire),
+	  text, len, h, i);
+	if (found != 0){ return found; }
+
+	/* Someone may have added it (or grown the table) since */
+	std::lock_guard<std::mutex> guard(myLock);
+	Table& table = *myTable.load(std::memory_order_relaxed);
+	found = find(table, text, len, h, i);
+	if (found != 0){ return found; }
+
+	size_t block = myCount >> BLOCK_BITS;
+	if (block == MAX_BLOCKS){ throw std::bad_alloc(); }
+	if (myBlocks[block] == nullptr){
+		myBlocks[block] = new Entry[BLOCK_SIZE];
+	}
+	Entry& e = myBlocks[block][myCount & (BLOCK_SIZE - 1)];
+	e.chars = store(text, len);
+	e.len = static_cast<uint32_t>(len);
+	e.hash = h;
+	myCount++;
+	StrHandle result = static_cast<StrHandle>(myCount);
+	// Readers may see the handle as soon as it is stored
+	table.slots[i].store(result, std::memory_order_release);
+	// Keep the load factor under 1/2
+	if (myCount * 2 > table.mask + 1){ grow(); }
+	return result;
+}
+
+}
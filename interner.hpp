@@ -0,0 +1,112 @@
+#ifndef DREWNO_MARS_INTERNER_H
+#define DREWNO_MARS_INTERNER_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace drewno_mars{
+
+/* A small, stable name for an interned string. Two handles
+   are equal exactly when their strings are, so comparing 
+   identifiers is a single integer compare. 0 is never handed 
+   out and can be used to mean "no string". */
+typedef uint32_t StrHandle;
+
+/**
+* \class Interner
+* Maps identifier and string literal text to StrHandles. The 
+* characters are copied once into a pool of fixed-size chunks 
+* that never move, so the pointer returned by chars() stays valid
+* for the life of the program.
+*
+* intern() may be called from several compilations at once. Entries
+* are likewise stored in blocks that never move, so looking up a 
+* handle (which a thread can only have obtained from intern()) 
+* needs no lock. Nor does finding a string that is already there,
+* which is what nearly every call does: the hash table's slots are
+* atomic, each handle is published only once its entry is filled
+* in, and a table outgrown by a larger one is kept for readers that
+* may still be probing it. Only adding a string takes the lock.
+**/
+class Interner{
+public:
+	/** The process-wide table used by the scanner and the AST **/
+	static Interner& global();
+
+	Interner();
+	~Interner();
+	Interner(const Interner&) = delete;
+	Interner& operator=(const Interner&) = delete;
+
+	StrHandle intern(const char * text, size_t len);
+	StrHandle intern(const std::string& text){
+		return intern(text.data(), text.size());
+	}
+
+	/** NUL-terminated text of a handle **/
+	const char * chars(StrHandle h) const { return entry(h).chars; }
+	size_t length(StrHandle h) const { return entry(h).len; }
+	std::string str(StrHandle h) const {
+		return std::string(chars(h), length(h));
+	}
+	void write(std::ostream& out, StrHandle h) const {
+		out.write(chars(h), static_cast<std::streamsize>(length(h)));
+	}
+
+	/** Number of distinct strings interned so far **/
+	size_t size() const;
+	/** Bytes held for the text, the entries and the table **/
+	size_t bytes() const;
+private:
+	struct Entry{
+		const char * chars;
+		uint32_t len;
+		uint32_t hash;
+	};
+	static const size_t BLOCK_BITS = 12;
+	static const size_t BLOCK_SIZE = size_t(1) << BLOCK_BITS;
+	static const size_t MAX_BLOCKS = 16 * 1024;
+
+	/* Open-addressed table of handles; 0 marks an empty slot.
+	   Its size is always a power of two. */
+	struct Table{
+		explicit Table(size_t size);
+		size_t mask;
+		std::unique_ptr<std::atomic<StrHandle>[]> slots;
+	};
+
+	const Entry& entry(StrHandle h) const { 
+		size_t i = h - 1;
+		return myBlocks[i >> BLOCK_BITS][i & (BLOCK_SIZE - 1)]; 
+	}
+	static uint32_t hash(const char * text, size_t len);
+	/* The handle for text in table, or 0 with i at the empty slot
+	   where it would go */
+	StrHandle find(const Table& table, const char * text, size_t len,
+	  uint32_t h, size_t& i) const;
+	const char * store(const char * text, size_t len);
+	void grow();
+
+	mutable std::mutex myLock;
+	/* Entry blocks, allocated as needed. The outer vector is sized
+	   once up front so that readers never see it reallocate. */
+	std::vector<Entry *> myBlocks;
+	size_t myCount = 0;
+	std::atomic<Table *> myTable;
+	/* Every table made, the current one last */
+	std::vector<std::unique_ptr<Table>> myTables;
+	size_t myTableBytes = 0;
+	std::vector<char *> myChunks;
+	size_t myChunkBytes = 0;
+	char * myCur = nullptr;
+	size_t myLeft = 0;
+};
+
+}
+
+#endif
@@ -1,92 +1,682 @@
 #include <iostream>
+#include <cerrno>
 #include <cstdlib>
+#include <algorithm>
 #include <cstring>
 #include <fstream>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
 #include "errors.hpp"
-#include "scanner.hpp"
+#include "diagnostics.hpp"
+#include "compilation.hpp"
+#include "threadpool.hpp"
+#include "writer.hpp"
+#include "incremental.hpp"
+#include "streaming.hpp"
+#include "server.hpp"
+#include "cache.hpp"
+#include "serialize.hpp"
+#include "stats.hpp"
 
 using namespace drewno_mars;
 
 static void usageAndDie(){
-	std::cerr << "Usage: dmc <infile>"
+	std::cerr << "Usage: dmc <infile | - for stdin | @listFile>..."
 	<< " [-u <unparseFile>]: Output canonical program form\n"
 	<< " [-p]: Parse the input to check syntax\n"
 	<< " [-t <tokensFile>]: Output tokens to <tokensFile>\n"
+	<< " [-a <astFile>]: Output the AST in binary form to <astFile>\n"
+	<< " [-l]: Load the inputs as AST files written by -a instead\n"
+	<< "   of parsing them\n"
+	<< " [-j <jobs>]: Compile up to <jobs> inputs at once\n"
+	<< " [-m <maxErrors>]: Report at most <maxErrors> errors per input\n"
+	<< " [-s <flex|fast|check>]: Pick the scanner, or check that\n"
+	<< "   both give the same tokens and errors\n"
+	<< " [-e <editFile>]: Apply the edits in <editFile> to the input,\n"
+	<< "   re-checking incrementally, and output for the result\n"
+	<< " [-c <cacheDir>]: Reuse (and save) results kept in <cacheDir>\n"
+	<< " [-S <socketPath | ->]: Run as a compile server on a Unix\n"
+	<< "   socket (or stdin and stdout), keeping results warm\n"
+	<< " [--stats]: Report each phase's wall and CPU time, and counts\n"
+	<< "   of tokens, nodes, positions and bytes, for each input\n"
+	<< " [--trace <traceFile>]: Write the same events to <traceFile>\n"
+	<< "   as Chrome trace-event JSON\n"
+	<< " [--mem-report]: Report memory in use after each phase, and\n"
+	<< "   what was allocated by category (node class, Position, ...)\n"
+	<< " [--max-depth <depth>]: Give up on input that nests the\n"
+	<< "   parser's stack deeper than <depth> (default "
+	<< DEFAULT_DEPTH_LIMIT << ", 0 for no limit)\n"
+	<< " [--flat]: Build the tree in flat form and expand it for -u\n"
+	<< "   and -a (with -l, flatten the loaded tree and expand it)\n"
+	<< " [--stream]: Parse the input as it is read (e.g. from a pipe),\n"
+	<< "   writing each declaration for -u as soon as it has parsed;\n"
+	<< "   this always uses the fast scanner\n"
+	<< "With several inputs, the -t, -u and -a arguments are suffixes\n"
+	<< "appended to each input's path (or -- for stdout), and\n"
+	<< "@listFile names a file listing one input per line\n"
 	;
 	exit(1);
 }
 
-static void writeTokenStream(const char * inPath, const char * outPath){
-	std::ifstream inStream(inPath);
-	if (!inStream.good()){
-		std::string msg = "Bad input stream";
-		msg += inPath;
+/* What the user asked for; the same for every input */
+struct Request{
+	const char * tokensFile = nullptr;
+	bool checkParse = false;
+	const char * unparseFile = nullptr;
+	const char * astFile = nullptr;
+	bool loadAST = false;
+	size_t maxErrors = 0;
+	ScannerKind scanner = ScannerKind::FLEX;
+	bool checkScanners = false;
+	const char * editsFile = nullptr;
+	const char * serverPath = nullptr;
+	OutputCache * cache = nullptr;
+	bool stats = false;
+	const char * traceFile = nullptr;
+	bool memReport = false;
+	size_t depthLimit = DEFAULT_DEPTH_LIMIT;
+	bool stream = false;
+	bool flat = false;
+};
+
+/* Where an output for inPath goes: the name given on the command
+   line, or in batch mode that name as a suffix to the input's */
+static std::string outputPath(const char * inPath, const char * arg, 
+  bool batch){
+	if (!batch || strcmp(arg, "--") == 0){ return arg; }
+	return std::string(inPath) + arg;
+}
+
+/* Open a -t or -u output file for writing, truncating it */
+static int openOutput(const char * outPath){
+	int fd = open(outPath, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+	if (fd < 0){
+		std::string msg = "Bad output file ";
+		msg += outPath;
 		throw new InternalError(msg.c_str());
 	}
+	return fd;
+}
+
+/* Hand emit a Writer for outPath: stdOut for "--", else the file.
+   The output is timed as the named phase in stats, if given. */
+template <typename Emit>
+static void writeOutput(const char * outPath, std::ostream& stdOut,
+  Stats * stats, const char * phase, Emit emit){
+	Stats::Phase timer(stats, phase);
+	size_t written;
+	if (strcmp(outPath, "--") == 0){
+		Writer writer(stdOut);
+		emit(writer);
+		writer.flush();
+		written = writer.written();
+	} else {
+		int fd = openOutput(outPath);
+		Writer writer(fd);
+		emit(writer);
+		writer.flush();
+		written = writer.written();
+		close(fd);
+	}
+	if (stats != nullptr){ stats->addWritten(written); }
+}
+
+static void writeTokenStream(Compilation& comp, const char * outPath,
+  std::ostream& stdOut, Stats * stats){
 	if (outPath == nullptr){
 		std::string msg = "No tokens output file given";
 		throw new InternalError(msg.c_str());
 	}
+	writeOutput(outPath, stdOut, stats, "tokens", [&comp](Writer& out){
+		comp.writeTokens(out);
+	});
+}
 
-	Scanner scanner(&inStream);
-	if (strcmp(outPath, "--") == 0){
-		scanner.outputTokens(std::cout);
-	} else {
-		std::ofstream outStream(outPath);
-		if (!outStream.good()){
-			std::string msg = "Bad output file ";
-			msg += outPath;
-			throw new InternalError(msg.c_str());
+static void outputAST(ASTNode * ast, const char * outPath, 
+  std::ostream& stdOut, Stats * stats){
+	writeOutput(outPath, stdOut, stats, "unparse", [ast](Writer& out){
+		ast->unparse(out, 0);
+	});
+}
+
+static void outputBinaryAST(ProgramNode * ast, const char * outPath,
+  std::ostream& stdOut, Stats * stats){
+	writeOutput(outPath, stdOut, stats, "ast", [ast](Writer& out){
+		writeAST(ast, out);
+	});
+}
+
+static bool doUnparsing(Compilation& comp, const char * outPath,
+  DiagnosticEngine& diags, std::ostream& stdOut, Stats * stats){
+	// A partial tree isn't worth unparsing
+	if (!comp.parsed()){ 
+		diags.note(DiagID::NO_AST);
+		return false;
+	}
+
+	outputAST(comp.ast(), outPath, stdOut, stats);
+	return true;
+}
+
+static bool sameToken(const TokenBuffer& a, const TokenBuffer& b, 
+  size_t i){
+	const Position& spanA = a.span(i);
+	const Position& spanB = b.span(i);
+	return a.kind(i) == b.kind(i) && a.payload(i) == b.payload(i)
+	  && spanA.lineBegin() == spanB.lineBegin()
+	  && spanA.colBegin() == spanB.colBegin()
+	  && spanA.lineEnd() == spanB.lineEnd()
+	  && spanA.colEnd() == spanB.colEnd();
+}
+
+/* Scan one input with both scanners and report the first place
+   where their tokens or diagnostics differ */
+static bool checkScanners(const char * inFile, DiagnosticEngine& diags){
+	SourceBuffer source(inFile);
+	DiagnosticEngine flexDiags;
+	DiagnosticEngine fastDiags;
+	TokenBuffer flexTokens;
+	TokenBuffer fastTokens;
+	Scanner(&source, &flexDiags).fill(flexTokens);
+	FastScanner(&source, &fastDiags).fill(fastTokens);
+
+	size_t count = std::min(flexTokens.size(), fastTokens.size());
+	for (size_t i = 0; i < count; i++){
+		if (!sameToken(flexTokens, fastTokens, i)){
+			diags.note(DiagID::TEXT, "Scanners disagree at token " 
+			  + std::to_string(i) + ": flex gives " 
+			  + flexTokens.at(i).toString() + ", fast gives "
+			  + fastTokens.at(i).toString());
+			return false;
+		}
+	}
+	if (flexTokens.size() != fastTokens.size()){
+		diags.note(DiagID::TEXT, "Scanners disagree on the token count: "
+		  + std::to_string(flexTokens.size()) + " from flex, "
+		  + std::to_string(fastTokens.size()) + " from fast");
+		return false;
+	}
+
+	const std::vector<Diagnostic>& flexList = flexDiags.diagnostics();
+	const std::vector<Diagnostic>& fastList = fastDiags.diagnostics();
+	for (size_t i = 0; i < flexList.size() || i < fastList.size(); i++){
+		std::string flexMsg = "nothing";
+		std::string fastMsg = "nothing";
+		if (i < flexList.size()){
+			flexMsg = flexList[i].span.span() + " " 
+			  + flexDiags.message(flexList[i]);
+		}
+		if (i < fastList.size()){
+			fastMsg = fastList[i].span.span() + " " 
+			  + fastDiags.message(fastList[i]);
+		}
+		if (flexMsg != fastMsg){
+			diags.note(DiagID::TEXT, "Scanners disagree at error " 
+			  + std::to_string(i) + ": flex gives " + flexMsg 
+			  + ", fast gives " + fastMsg);
+			return false;
+		}
+	}
+	return true;
+}
+
+/* One change to the text, as read from an edit file */
+struct Edit{
+	size_t offset;
+	size_t removed;
+	std::string inserted;
+};
+
+/* Each line of an edit file is "<offset> <removed> <text>", where
+   text runs to the end of the line and may use \n, \t and \\ */
+static std::vector<Edit> readEdits(const char * path){
+	std::ifstream file(path);
+	if (!file.good()){
+		std::string msg = "Bad edit file ";
+		msg += path;
+		throw new UserError(msg.c_str());
+	}
+	std::vector<Edit> edits;
+	std::string line;
+	while (std::getline(file, line)){
+		if (line.empty()){ continue; }
+		std::istringstream fields(line);
+		Edit edit;
+		if (!(fields >> edit.offset >> edit.removed)){
+			std::string msg = "Bad edit: " + line;
+			throw new UserError(msg.c_str());
+		}
+		std::string text;
+		fields.get();
+		std::getline(fields, text);
+		for (size_t k = 0; k < text.size(); k++){
+			if (text[k] == '\\' && k + 1 < text.size()){
+				k++;
+				if (text[k] == 'n'){ edit.inserted += '\n'; }
+				else if (text[k] == 't'){ edit.inserted += '\t'; }
+				else { edit.inserted += text[k]; }
+			} else {
+				edit.inserted += text[k];
+			}
+		}
+		edits.push_back(edit);
+	}
+	return edits;
+}
+
+/* Load one input into an incremental session, apply the edits in
+   order and produce the requested outputs for the edited text */
+static void compileEdited(const char * inFile, const Request& req,
+  bool batch, std::ostream& out, DiagnosticEngine& diags, Stats * stats){
+	std::vector<Edit> edits = readEdits(req.editsFile);
+	SourceBuffer source(inFile);
+	if (stats != nullptr){ stats->addRead(source.size()); }
+	IncrementalSession session(source.data(), source.size(),
+	  req.depthLimit);
+	for (const Edit& edit : edits){
+		session.edit(edit.offset, edit.removed, edit.inserted);
+	}
+	session.report(diags);
+
+	if (req.tokensFile != nullptr){
+		std::string path = outputPath(inFile, req.tokensFile, batch);
+		writeOutput(path.c_str(), out, stats, "tokens",
+		  [&session](Writer& w){
+			session.writeTokens(w);
+		});
+	} if (req.checkParse){
+		if (!session.parsed()){
+			diags.note(DiagID::PARSE_FAILED);
+		}
+	} if (req.unparseFile != nullptr){
+		ProgramNode * ast = session.program();
+		if (ast == nullptr){
+			diags.note(DiagID::NO_AST);
+		} else {
+			std::string path = outputPath(inFile, req.unparseFile, batch);
+			outputAST(ast, path.c_str(), out, stats);
+		}
+	}
+}
+
+/* Produce the requested outputs from a cache entry, running the 
+   compilation first if the cache doesn't have it. A miss always 
+   keeps the token dump and the unparsed program, whichever were 
+   asked for, so that later runs can be served from the entry. */
+static void compileCached(const char * inFile, const Request& req,
+  bool batch, std::ostream& out, DiagnosticEngine& diags, Stats * stats){
+	bool wantTokens = req.tokensFile != nullptr;
+	bool wantAST = req.checkParse || req.unparseFile != nullptr;
+	OutputCache::Entry entry;
+	Compilation comp(inFile, entry.diags, req.scanner);
+	comp.setStats(stats);
+	comp.setDepthLimit(req.depthLimit);
+	comp.setFlat(req.flat);
+	std::string key = req.cache->key(comp.source().data(),
+	  comp.source().size(), wantTokens, req.depthLimit);
+	if (!req.cache->load(key, entry)){
+		comp.run(wantTokens, true);
+		entry.parsed = comp.parsed();
+		if (wantTokens){
+			std::ostringstream tokens;
+			Writer writer(tokens);
+			comp.writeTokens(writer);
+			writer.flush();
+			entry.tokens = tokens.str();
+		}
+		if (comp.parsed()){
+			std::ostringstream unparsed;
+			Writer writer(unparsed);
+			comp.ast()->unparse(writer, 0);
+			writer.flush();
+			entry.unparsed = unparsed.str();
 		}
-		scanner.outputTokens(outStream);
-		outStream.close();
+		req.cache->store(key, entry);
+	}
+
+	for (const Diagnostic& diag : entry.diags.diagnostics()){
+		// The parse was only for the cache's sake
+		if (!wantAST && diag.severity == Severity::ERROR){ continue; }
+		diags.report(diag.severity, diag.id, diag.span, 
+		  entry.diags.arg(diag));
+	}
+	if (wantTokens){
+		std::string path = outputPath(inFile, req.tokensFile, batch);
+		writeOutput(path.c_str(), out, stats, "tokens",
+		  [&entry](Writer& writer){
+			writer.write(entry.tokens.data(), entry.tokens.size());
+		});
+	} if (req.checkParse){
+		if (!entry.parsed){
+			diags.note(DiagID::PARSE_FAILED);
+		}
+	} if (req.unparseFile != nullptr){
+		if (!entry.parsed){
+			diags.note(DiagID::NO_AST);
+		} else {
+			std::string path = outputPath(inFile, req.unparseFile, batch);
+			writeOutput(path.c_str(), out, stats, "unparse",
+			  [&entry](Writer& writer){
+				writer.write(entry.unparsed.data(), entry.unparsed.size());
+			});
+		}
+	}
+}
+
+/* Produce the outputs for an AST file written by -a, without 
+   scanning or parsing anything */
+static void compileLoaded(const char * inFile, const Request& req,
+  bool batch, std::ostream& out, Stats * stats){
+	if (req.tokensFile != nullptr){
+		throw new UserError("An AST file has no tokens to output");
+	}
+	SourceBuffer source(inFile);
+	Arena arena;
+	if (stats != nullptr){ arena.setProfile(stats->arenaProfile()); }
+	ProgramNode * ast;
+	{
+		Stats::Phase phase(stats, "load");
+		ast = readAST(source.data(), source.size(), arena);
+	}
+	if (req.flat){
+		Stats::Phase phase(stats, "flatten");
+		FlatAST flat;
+		flattenAST(ast, flat);
+		ast = expandAST(flat, arena);
+	}
+	if (stats != nullptr){
+		stats->addRead(source.size());
+		stats->countNodes(ast);
+	}
+	if (req.unparseFile != nullptr){
+		std::string path = outputPath(inFile, req.unparseFile, batch);
+		outputAST(ast, path.c_str(), out, stats);
+	} if (req.astFile != nullptr){
+		std::string path = outputPath(inFile, req.astFile, batch);
+		outputBinaryAST(ast, path.c_str(), out, stats);
 	}
 }
 
-static drewno_mars::ProgramNode * parse(const char * inFile){
-	std::ifstream inStream(inFile);
-	if (!inStream.good()){
+/* Parse one input as it is read, e.g. from a generator's pipe, and
+   unparse each declaration once it has parsed. The output keeps up
+   with the input: it is flushed after every read, along with the
+   diagnostics so far unless they are being kept for a batch. After
+   a syntax error no more declarations are written. */
+static void compileStreamed(const char * inFile, const Request& req,
+  bool batch, std::ostream& out, DiagnosticEngine& diags, Stats * stats){
+	if (req.tokensFile != nullptr || req.astFile != nullptr
+	    || req.loadAST || req.editsFile != nullptr){
+		throw new UserError("--stream only supports -p and -u");
+	}
+	bool isStdin = strcmp(inFile, "-") == 0;
+	int inFd = isStdin ? STDIN_FILENO : open(inFile, O_RDONLY);
+	if (inFd < 0){
 		std::string msg = "Bad input stream ";
 		msg += inFile;
 		throw new UserError(msg.c_str());
 	}
 
-	//This pointer will be set to the root of the
-	// AST after parsing
-	drewno_mars::ProgramNode * root = nullptr;
+	std::unique_ptr<Writer> writer;
+	bool toStdout = false;
+	int outFd = -1;
+	if (req.unparseFile != nullptr){
+		std::string path = outputPath(inFile, req.unparseFile, batch);
+		toStdout = path == "--";
+		if (toStdout){
+			writer.reset(new Writer(out));
+		} else {
+			outFd = openOutput(path.c_str());
+			writer.reset(new Writer(outFd));
+		}
+	}
 
-	drewno_mars::Scanner scanner(&inStream);
-	drewno_mars::Parser parser(scanner, &root);
+	StreamParser stream(diags, [&writer, &stream](DeclNode * decl){
+		if (writer != nullptr && stream.parsed()){
+			decl->unparse(*writer, 0);
+		}
+	}, req.depthLimit);
+	if (stats != nullptr){ stream.setProfile(stats->arenaProfile()); }
+	size_t read = 0;
+	{
+		Stats::Phase phase(stats, "stream");
+		std::vector<char> buf(64 * 1024);
+		while (true){
+			ssize_t got = ::read(inFd, buf.data(), buf.size());
+			if (got == 0){ break; }
+			if (got < 0){
+				if (errno == EINTR){ continue; }
+				if (!isStdin){ close(inFd); }
+				writer.reset();
+				if (outFd >= 0){ close(outFd); }
+				std::string msg = "Bad input stream ";
+				msg += inFile;
+				throw new UserError(msg.c_str());
+			}
+			read += static_cast<size_t>(got);
+			stream.feed(buf.data(), static_cast<size_t>(got));
+			if (writer != nullptr){
+				writer->flush();
+				if (toStdout){ out.flush(); }
+			}
+			if (!batch){ diags.flush(out, std::cerr); }
+		}
+		stream.finish();
+	}
+	if (!isStdin){ close(inFd); }
+	if (writer != nullptr){
+		writer->flush();
+		if (stats != nullptr){ stats->addWritten(writer->written()); }
+		writer.reset();
+	}
+	if (outFd >= 0){ close(outFd); }
+	if (stats != nullptr){ stats->addRead(read); }
 
-	int errCode = parser.parse();
-	if (errCode != 0){ return nullptr; }
+	if (req.checkParse){
+		if (!stream.parsed()){
+			diags.note(DiagID::PARSE_FAILED);
+		}
+	} if (req.unparseFile != nullptr){
+		if (!stream.parsed()){
+			diags.note(DiagID::NO_AST);
+		}
+	}
+}
 
-	return root;
+/* Run every requested phase over one input, sending "--" outputs 
+   to out and collecting messages in diags for the caller to flush. 
+   Phases are timed and counted into stats unless it is null.
+   Returns false if the compiler had to give up on the input. */
+static bool compileOne(const char * inFile, const Request& req, 
+  bool batch, std::ostream& out, DiagnosticEngine& diags, 
+  Stats * stats){
+	try {
+		if (req.checkScanners){
+			return checkScanners(inFile, diags);
+		}
+		if (req.stream){
+			compileStreamed(inFile, req, batch, out, diags, stats);
+			return true;
+		}
+		if (req.editsFile != nullptr){
+			compileEdited(inFile, req, batch, out, diags, stats);
+			return true;
+		}
+		if (req.loadAST){
+			compileLoaded(inFile, req, batch, out, stats);
+			return true;
+		}
+		// Cache entries don't hold the AST itself
+		if (req.cache != nullptr && req.astFile == nullptr){
+			compileCached(inFile, req, batch, out, diags, stats);
+			return true;
+		}
+		/* Scan (and if needed parse) once, then serve
+		   every requested output from the same results */
+		bool wantTokens = req.tokensFile != nullptr;
+		bool wantAST = req.checkParse || req.unparseFile != nullptr
+		  || req.astFile != nullptr;
+		Compilation comp(inFile, diags, req.scanner);
+		comp.setDepthLimit(req.depthLimit);
+		comp.setFlat(req.flat);
+		comp.setStats(stats);
+		comp.run(wantTokens, wantAST);
+
+		if (wantTokens){
+			std::string path = outputPath(inFile, req.tokensFile, batch);
+			writeTokenStream(comp, path.c_str(), out, stats);
+		} if (req.checkParse){
+			if (!comp.parsed()){
+				diags.note(DiagID::PARSE_FAILED);
+			}
+		} if (req.unparseFile != nullptr){
+			std::string path = outputPath(inFile, req.unparseFile, batch);
+			doUnparsing(comp, path.c_str(), diags, out, stats);
+		} if (req.astFile != nullptr){
+			if (comp.parsed()){
+				std::string path = outputPath(inFile, req.astFile, batch);
+				outputBinaryAST(comp.ast(), path.c_str(), out, stats);
+			} else {
+				diags.note(DiagID::NO_AST);
+			}
+		}
+	} catch (ToDoError * e){
+		diags.note(DiagID::TEXT, std::string("ToDo: ") + e->msg());
+		return false;
+	} catch (InternalError * e){
+		std::string msg = "Something in the compiler is broken: ";
+		diags.note(DiagID::TEXT, msg + e->msg());
+		return false;
+	} catch (UserError * e){
+		std::string msg = "The user made a mistake: ";
+		diags.note(DiagID::TEXT, msg + e->msg());
+		return false;
+	}
+	return true;
 }
 
-static void outputAST(ASTNode * ast, const char * outPath){
-	if (strcmp(outPath, "--") == 0){
-		ast->unparse(std::cout, 0);
-	} else {
-		std::ofstream outStream(outPath);
-		if (!outStream.good()){
-			std::string msg = "Bad output file ";
-			msg += outPath;
-			throw new drewno_mars::InternalError(msg.c_str());
+/* The Stats kept for input k, or null if none are being kept */
+static Stats * statsFor(const std::vector<std::unique_ptr<Stats>>& stats,
+  size_t k){
+	return stats.empty() ? nullptr : stats[k].get();
+}
+
+static void reportStats(const Request& req, const Stats * stats){
+	if (req.stats){ stats->report(std::cerr); }
+	if (req.memReport){ stats->memoryReport(std::cerr); }
+}
+
+/* Compile every input on a thread pool. Each compilation buffers
+   its own stdout text and diagnostics, which are written out in 
+   input order: each input's as soon as it and all those before it
+   are done, so finished output isn't held until the end. */
+static bool compileBatch(const std::vector<std::string>& inputs, 
+  const Request& req, size_t jobs, 
+  const std::vector<std::unique_ptr<Stats>>& stats){
+	struct Result{
+		std::ostringstream out;
+		DiagnosticEngine diags;
+		bool ok = true;
+		bool done = false;
+	};
+	std::vector<std::unique_ptr<Result>> results;
+	std::mutex lock;
+	std::condition_variable finished;
+	bool ok = true;
+	ThreadPool pool(jobs);
+	for (size_t k = 0; k < inputs.size(); k++){
+		results.emplace_back(new Result());
+		Result * res = results.back().get();
+		res->diags.setLimit(req.maxErrors);
+		const char * inFile = inputs[k].c_str();
+		Stats * inStats = statsFor(stats, k);
+		pool.submit([res, inFile, &req, inStats, &lock, &finished](){
+			bool done = false;
+			// Anything else thrown fails this input, not the batch
+			try {
+				done = compileOne(inFile, req, true, 
+				  res->out, res->diags, inStats);
+			} catch (std::exception& e){
+				std::string msg = "Something in the compiler is broken: ";
+				res->diags.note(DiagID::TEXT, msg + e.what());
+			} catch (...){
+				res->diags.note(DiagID::TEXT, 
+				  "Something in the compiler is broken");
+			}
+			std::lock_guard<std::mutex> guard(lock);
+			res->ok = done;
+			res->done = true;
+			finished.notify_all();
+		});
+	}
+
+	for (size_t k = 0; k < inputs.size(); k++){
+		{
+			std::unique_lock<std::mutex> wait(lock);
+			finished.wait(wait, [&results, k](){ return results[k]->done; });
+		}
+		std::cout << results[k]->out.str();
+		if (!results[k]->diags.empty()){
+			std::cerr << inputs[k] << ":\n";
+			results[k]->diags.flush(std::cout, std::cerr);
 		}
-		ast->unparse(outStream, 0);
+		std::cout.flush();
+		reportStats(req, statsFor(stats, k));
+		ok = ok && results[k]->ok;
+		results[k].reset();
 	}
+	pool.wait();
+	return ok;
 }
 
-static bool doUnparsing(const char * inputPath, const char * outPath){
-	drewno_mars::ProgramNode * ast = parse(inputPath);
-	if (ast == nullptr){ 
-		std::cerr << "No AST built\n";
-		return false;
+/* Answer compile requests until told to shut down */
+static int serve(const Request& req, size_t jobs){
+	CompileServer server(req.scanner, req.maxErrors, req.depthLimit);
+	try {
+		if (strcmp(req.serverPath, "-") == 0){
+			server.serve(STDIN_FILENO, STDOUT_FILENO);
+		} else {
+			server.listen(req.serverPath, jobs);
+		}
+	} catch (UserError * e){
+		std::cerr << "The user made a mistake: " << e->msg() << "\n";
+		return 1;
 	}
+	return 0;
+}
 
-	outputAST(ast, outPath);
-	return true;
+static void writeTrace(const char * path,
+  const std::vector<std::unique_ptr<Stats>>& stats){
+	std::ofstream file(path);
+	if (!file.good()){
+		std::cerr << "Bad trace file " << path << std::endl;
+		exit(1);
+	}
+	std::vector<const Stats *> inputs;
+	for (const std::unique_ptr<Stats>& input : stats){
+		inputs.push_back(input.get());
+	}
+	Stats::writeTrace(file, inputs);
+}
+
+/* Add each line of a response file as an input */
+static void readListFile(const char * path, 
+  std::vector<std::string>& inputs){
+	std::ifstream list(path);
+	if (!list.good()){
+		std::cerr << "Bad input list " << path << std::endl;
+		usageAndDie();
+	}
+	std::string line;
+	while (std::getline(list, line)){
+		if (!line.empty()){ inputs.push_back(line); }
+	}
 }
 
 int 
@@ -95,44 +685,112 @@ main( const int argc, const char **argv )
 	if (argc == 0){
 		usageAndDie();
 	}
-	const char * inFile = NULL;
-	const char * tokensFile = NULL;
-	bool checkParse = false;
-	const char * unparseFile = NULL;
+	std::vector<std::string> inputs;
+	Request req;
+	size_t jobs = std::thread::hardware_concurrency();
 
+	const char * cacheDir = nullptr;
 	bool useful = false;
-	int i = 1;
+	// Any -s but fast, which --stream can't honor
+	bool slowScanner = false;
 	for (int i = 1 ; i < argc ; i++){
-		if (argv[i][0] == '-'){
+		if (strcmp(argv[i], "--stats") == 0){
+			req.stats = true;
+		} else if (strcmp(argv[i], "--mem-report") == 0){
+			req.memReport = true;
+		} else if (strcmp(argv[i], "--trace") == 0){
+			i++;
+			if (i >= argc){ usageAndDie(); }
+			req.traceFile = argv[i];
+		} else if (strcmp(argv[i], "--flat") == 0){
+			req.flat = true;
+		} else if (strcmp(argv[i], "--stream") == 0){
+			req.stream = true;
+		} else if (strcmp(argv[i], "--max-depth") == 0){
+			i++;
+			if (i >= argc){ usageAndDie(); }
+			int depth = atoi(argv[i]);
+			if (depth < 0){ usageAndDie(); }
+			req.depthLimit = static_cast<size_t>(depth);
+		} else if (argv[i][0] == '-' && argv[i][1] != '\0'){
 			if (argv[i][1] == 't'){
 				i++;
-				tokensFile = argv[i];
+				req.tokensFile = argv[i];
 				useful = true;
 			} else if (argv[i][1] == 'p'){
-				i++;
-				checkParse = true;
+				req.checkParse = true;
 				useful = true;
 			} else if (argv[i][1] == 'u'){
 				i++;
 				if (i >= argc){ usageAndDie(); }
-				unparseFile = argv[i];
+				req.unparseFile = argv[i];
+				useful = true;
+			} else if (argv[i][1] == 'a'){
+				i++;
+				if (i >= argc){ usageAndDie(); }
+				req.astFile = argv[i];
+				useful = true;
+			} else if (argv[i][1] == 'l'){
+				req.loadAST = true;
+			} else if (argv[i][1] == 'j'){
+				i++;
+				if (i >= argc){ usageAndDie(); }
+				int count = atoi(argv[i]);
+				if (count < 1){ usageAndDie(); }
+				jobs = static_cast<size_t>(count);
+			} else if (argv[i][1] == 'm'){
+				i++;
+				if (i >= argc){ usageAndDie(); }
+				int count = atoi(argv[i]);
+				if (count < 1){ usageAndDie(); }
+				req.maxErrors = static_cast<size_t>(count);
+			} else if (argv[i][1] == 'e'){
+				i++;
+				if (i >= argc){ usageAndDie(); }
+				req.editsFile = argv[i];
+			} else if (argv[i][1] == 'c'){
+				i++;
+				if (i >= argc){ usageAndDie(); }
+				cacheDir = argv[i];
+			} else if (argv[i][1] == 'S'){
+				i++;
+				if (i >= argc){ usageAndDie(); }
+				req.serverPath = argv[i];
 				useful = true;
+			} else if (argv[i][1] == 's'){
+				i++;
+				if (i >= argc){ usageAndDie(); }
+				if (strcmp(argv[i], "fast") == 0){
+					req.scanner = ScannerKind::FAST;
+				} else if (strcmp(argv[i], "check") == 0){
+					req.checkScanners = true;
+					slowScanner = true;
+					useful = true;
+				} else if (strcmp(argv[i], "flex") == 0){
+					slowScanner = true;
+				} else {
+					usageAndDie();
+				}
 			} else {
 				std::cerr << "Unrecognized argument: ";
 				std::cerr << argv[i] << std::endl;
 				usageAndDie();
 			}
+		} else if (argv[i][0] == '@'){
+			readListFile(argv[i] + 1, inputs);
 		} else {
-			if (inFile == NULL){
-				inFile = argv[i];
-			} else {
-				std::cerr << "Only 1 input file allowed";
-				std::cerr << argv[i] << std::endl;
-				usageAndDie();
-			}
+			inputs.push_back(argv[i]);
 		}
 	}
-	if (inFile == NULL){
+	if (req.stream && slowScanner){
+		std::cerr << "--stream only works with the fast scanner\n";
+		usageAndDie();
+	}
+	if (req.serverPath != nullptr){
+		if (!inputs.empty()){ usageAndDie(); }
+		return serve(req, jobs);
+	}
+	if (inputs.empty()){
 		usageAndDie();
 	}
 	if (!useful){
@@ -140,27 +798,44 @@ main( const int argc, const char **argv )
 		usageAndDie();
 	}
 
-	try {
-		if (tokensFile != NULL){
-			writeTokenStream(inFile, tokensFile);
-		} if (checkParse){
-			bool parsed = parse(inFile);
-			if (!parsed){
-				std::cerr << "Parse failed" << std::endl;
-			}
-		} if (unparseFile != nullptr){
-			doUnparsing(inFile, unparseFile);
+	std::unique_ptr<OutputCache> cache;
+	if (cacheDir != nullptr){
+		try {
+			cache.reset(new OutputCache(cacheDir));
+		} catch (UserError * e){
+			std::cerr << "The user made a mistake: " << e->msg() << "\n";
+			exit(1);
 		}
-	} catch (ToDoError * e){
-		std::cerr << "ToDo: " << e->msg() << std::endl;
-		exit(1);
-	} catch (InternalError * e){
-		std::string msg = "Something in the compiler is broken: ";
-		std::cerr << msg << e->msg() << std::endl;
-		exit(1);
-	} catch (UserError * e){
-		std::string msg = "The user made a mistake: ";
-		std::cerr << msg << e->msg() << std::endl;
+		req.cache = cache.get();
+	}
+
+	// Kept only when asked for, so that otherwise every hook is idle
+	std::vector<std::unique_ptr<Stats>> stats;
+	if (req.stats || req.traceFile != nullptr || req.memReport){
+		for (const std::string& input : inputs){
+			stats.emplace_back(new Stats(input));
+			stats.back()->setMemory(req.memReport);
+		}
+	}
+
+	bool ok = true;
+	if (inputs.size() == 1){
+		DiagnosticEngine diags(req.maxErrors);
+		ok = compileOne(inputs[0].c_str(), req, false, 
+		  std::cout, diags, statsFor(stats, 0));
+		diags.flush(std::cout, std::cerr);
+		reportStats(req, statsFor(stats, 0));
+	} else {
+		ok = compileBatch(inputs, req, jobs, stats);
+	}
+	if (req.traceFile != nullptr){
+		writeTrace(req.traceFile, stats);
+	}
+	if (cache != nullptr){
+		std::cerr << "Cache: " << cache->hits() << " hits, " 
+		  << cache->misses() << " misses\n";
+	}
+	if (!ok){
 		exit(1);
 	}
 	
@@ -0,0 +1,90 @@
+#ifndef DREWNO_MARS_NODELIST_H
+#define DREWNO_MARS_NODELIST_H
+
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+#include "arena.hpp"
+
+namespace drewno_mars{
+
+/**
+* \class NodeList
+* A growable array of AST node pointers whose storage comes from the
+* compilation's Arena. Children sit next to each other in memory, so
+* walking them is a linear scan rather than a chase through list
+* nodes. When the array fills up a larger one is carved out of the
+* arena and the old one is simply abandoned; the arena takes it back
+* on reset along with everything else.
+**/
+template <typename T>
+class NodeList{
+	static_assert(std::is_pointer<T>::value,
+	  "NodeList only holds node pointers");
+public:
+	explicit NodeList(Arena& arenaIn) : myArena(&arenaIn){ }
+
+	void push_back(T item){
+		if (mySize == myCapacity){
+			grow(myCapacity == 0 ? 4 : myCapacity * 2);
+		}
+		myItems[mySize++] = item;
+	}
+
+	/** Make room for at least capacity items **/
+	void reserve(size_t capacity){
+		if (capacity > myCapacity){ grow(capacity); }
+	}
+
+	/** Replace the removed items from index at on with the count
+	    items at items, moving the ones after them along **/
+	void replace(size_t at, size_t removed, const T * items, size_t count){
+		size_t size = mySize - removed + count;
+		if (size > myCapacity){
+			grow(size > myCapacity * 2 ? size : myCapacity * 2);
+		}
+		size_t after = mySize - at - removed;
+		if (after > 0 && count != removed){
+			std::memmove(myItems + at + count, myItems + at + removed,
+			  sizeof(T) * after);
+		}
+		if (count > 0){
+			std::memcpy(myItems + at, items, sizeof(T) * count);
+		}
+		mySize = size;
+	}
+
+	size_t size() const { return mySize; }
+	bool empty() const { return mySize == 0; }
+	T operator[](size_t i) const { return myItems[i]; }
+	T front() const { return myItems[0]; }
+	T back() const { return myItems[mySize - 1]; }
+
+	T * begin(){ return myItems; }
+	T * end(){ return myItems + mySize; }
+	const T * begin() const { return myItems; }
+	const T * end() const { return myItems + mySize; }
+private:
+	void grow(size_t capacity){
+		void * mem = myArena->allocate(sizeof(T) * capacity, alignof(T),
+		  "NodeList items");
+		T * items = static_cast<T *>(mem);
+		if (mySize > 0){
+			std::memcpy(items, myItems, sizeof(T) * mySize);
+		}
+		myItems = items;
+		myCapacity = capacity;
+	}
+
+	Arena * myArena;
+	T * myItems = nullptr;
+	size_t mySize = 0;
+	size_t myCapacity = 0;
+};
+
+template <typename T>
+const char * arenaCategory(const NodeList<T> *){ return "NodeList"; }
+
+}
+
+#endif
@@ -1,26 +1,38 @@
 #ifndef DREWNO_MARS_POSITION_H
 #define DREWNO_MARS_POSITION_H
 
+#include <cstdint>
 #include <string>
 
 namespace drewno_mars{
 
+/* A source span. This is a plain, trivially copyable value
+   (four 32-bit fields, no vtable) so that it can be embedded
+   in tokens and passed around by value. */
 class Position{
 public: 
+	Position() = default;
 	Position(size_t lineI, size_t colI, size_t lineE, size_t colE)
-	: myLineI(lineI), myColI(colI), myLineE(lineE), myColE(colE){
+	: myLineI(static_cast<uint32_t>(lineI)),
+	  myColI(static_cast<uint32_t>(colI)),
+	  myLineE(static_cast<uint32_t>(lineE)),
+	  myColE(static_cast<uint32_t>(colE)){
 	}
 	Position(const Position * start, const Position * end)
 	: myLineI(start->myLineI), myColI(start->myColI),
 	  myLineE(end->myLineE),myColE(end->myColE){
 	}
-	virtual void expand(const Position * start, const Position * end){
+	void expand(const Position * start, const Position * end){
 	  myLineI = start->myLineI;
 	  myColI = start->myColI;
 	  myLineE = end->myLineE;
 	  myColE = end->myColE;
 	}
-	virtual std::string begin() const{
+	size_t lineBegin() const { return myLineI; }
+	size_t colBegin() const { return myColI; }
+	size_t lineEnd() const { return myLineE; }
+	size_t colEnd() const { return myColE; }
+	std::string begin() const{
 		std::string result = "[" 
 		+ std::to_string(myLineI)
 		+ "," 
@@ -28,7 +40,7 @@ public:
 		+ "]";
 		return result;
 	}
-	virtual std::string span() const{
+	std::string span() const{
 		std::string result = begin()
 		+ "-[" 
 		+ std::to_string(myLineE)
@@ -38,13 +50,15 @@ public:
 		return result;
 	}
 private:
-	size_t myLineI;
-	size_t myColI;
-	size_t myLineE;
-	size_t myColE;
+	uint32_t myLineI;
+	uint32_t myColI;
+	uint32_t myLineE;
+	uint32_t myColE;
 
 };
 
+inline const char * arenaCategory(const Position *){ return "Position"; }
+
 }
 
 #endif
@@ -1,3 +1,4 @@
+#include <cstring>
 #include <fstream>
 #include "scanner.hpp"
 
@@ -6,20 +7,22 @@ using namespace drewno_mars;
 using TokenKind = drewno_mars::Parser::token;
 using Lexeme = drewno_mars::Parser::semantic_type;
 
-void Scanner::outputTokens(std::ostream& outstream){
-	Lexeme lex;
-	int tokenKind;
-	while(true){
-		tokenKind = this->yylex(&lex);
-		if (tokenKind == TokenKind::END){
-			outstream << "EOF" 
-			  << " [" << this->lineNum 
-			  << "," << this->colNum << "]"
-			  << std::endl;
-			return;
-		} else {
-			outstream << lex.lexeme->toString()
-			  << std::endl;
-		}
+int Scanner::LexerInput(char * buf, int max_size){
+	if (mySource == nullptr){
+		return yyFlexLexer::LexerInput(buf, max_size);
 	}
+	/* Hand flex the next block of the source straight from
+	   memory; there is no stream or locale layer in between */
+	size_t left = mySource->size() - mySourceOffset;
+	size_t count = static_cast<size_t>(max_size);
+	if (left < count){ count = left; }
+	memcpy(buf, mySource->data() + mySourceOffset, count);
+	mySourceOffset += count;
+	return static_cast<int>(count);
+}
+
+void Scanner::outputTokens(std::ostream& outstream){
+	TokenBuffer tokens;
+	fill(tokens);
+	tokens.write(outstream);
 }
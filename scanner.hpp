@@ -7,18 +7,27 @@
 
 #include "frontend.hh" // Token kind definitions
 #include "errors.hpp"  // Error reporting
+#include "diagnostics.hpp" // Diagnostics for the user
+#include "source.hpp"  // In-memory input
+#include "tokenbuffer.hpp" // Materialized token streams
 
 using TokenKind = drewno_mars::Parser::token;
 
 namespace drewno_mars{
 
-class Scanner : public yyFlexLexer{
+class Scanner : public yyFlexLexer, public Lexer{
 public:
    
-   Scanner(std::istream *in) : yyFlexLexer(in)
+   Scanner(std::istream *in, DiagnosticEngine * diagsIn)
+   : yyFlexLexer(in), myDiags(diagsIn)
+   {
+   };
+
+   /* Scan the text of src directly, bypassing iostreams. src 
+      must outlive the scanner. */
+   Scanner(const SourceBuffer * src, DiagnosticEngine * diagsIn)
+   : yyFlexLexer(nullptr), myDiags(diagsIn), mySource(src)
    {
-	lineNum = 1;
-	colNum = 1;
    };
    virtual ~Scanner() {
    };
@@ -31,36 +40,39 @@ public:
 
    int makeBareToken(int tagIn){
 	size_t len = static_cast<size_t>(yyleng);
-	Position * pos = new Position(
+	Position pos(
 	  this->lineNum, this->colNum,
 	  this->lineNum, this->colNum+len);
-        this->yylval->lexeme = new Token(pos, tagIn);
+        this->yylval->transToken = Token(pos, tagIn);
         colNum += len;
         return tagIn;
    }
 
+   /* Intern the text of an ID or STRINGLITERAL, giving the
+      handle that the token carries as its payload */
+   StrHandle internText(){
+	return Interner::global().intern(yytext,
+	  static_cast<size_t>(yyleng));
+   }
+
    void errIllegal(Position * pos, std::string match){
-	drewno_mars::Report::fatal(pos, "Illegal character "
-		+ match);
+	myDiags->report(Severity::FATAL, DiagID::ILLEGAL_CHAR, *pos, match);
    }
 
    void errStrEsc(Position * pos){
-	drewno_mars::Report::fatal(pos, "String literal with bad"
-	" escape sequence ignored");
+	myDiags->report(Severity::FATAL, DiagID::STR_BAD_ESC, *pos);
    }
 
    void errStrUnterm(Position * pos){
-	drewno_mars::Report::fatal(pos, "Unterminated string"
-	" literal ignored");
+	myDiags->report(Severity::FATAL, DiagID::STR_UNTERM, *pos);
    }
 
    void errStrEscAndUnterm(Position * pos){
-	drewno_mars::Report::fatal(pos, "Unterminated string literal"
-	" with bad escape sequence ignored");
+	myDiags->report(Severity::FATAL, DiagID::STR_BAD_ESC_UNTERM, *pos);
    }
 
    void errIntOverflow(Position * pos){
-	drewno_mars::Report::fatal(pos, "Integer literal overflow");
+	myDiags->report(Severity::FATAL, DiagID::INT_OVERFLOW, *pos);
    }
 /*
    void warn(int lineNumIn, int colNumIn, std::string msg){
@@ -78,10 +90,20 @@ public:
 
    void outputTokens(std::ostream& outstream);
 
+protected:
+   // The parser reaches yylex through Lexer::nextToken
+   int scanToken(drewno_mars::Parser::semantic_type * lval) override{
+	return this->yylex(lval);
+   }
+
+   // Flex pulls its input through here
+   int LexerInput(char * buf, int max_size) override;
+
 private:
    drewno_mars::Parser::semantic_type *yylval = nullptr;
-   size_t lineNum;
-   size_t colNum;
+   DiagnosticEngine * myDiags;
+   const SourceBuffer * mySource = nullptr;
+   size_t mySourceOffset = 0;
 };
 
 } /* end namespace */
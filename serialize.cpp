@@ -0,0 +1,661 @@
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "serialize.hpp"
+#include "errors.hpp"
+#include "visitor.hpp"
+
+namespace drewno_mars{
+
+static const char MAGIC[] = "dmc-ast 2\n";
+static const size_t MAGIC_LEN = sizeof(MAGIC) - 1;
+/* Set in a record's kind byte when the node has no position */
+static const uint8_t NO_POSITION = 0x80;
+
+static uint64_t zigzag(int64_t value){
+	uint64_t bits = static_cast<uint64_t>(value);
+	return (bits << 1) ^ (value < 0 ? UINT64_MAX : 0);
+}
+
+static int64_t unzigzag(uint64_t bits){
+	uint64_t value = (bits >> 1) ^ (0 - (bits & 1));
+	int64_t result;
+	memcpy(&result, &value, sizeof(result));
+	return result;
+}
+
+static int64_t difference(size_t a, size_t b){
+	return static_cast<int64_t>(a) - static_cast<int64_t>(b);
+}
+
+/**
+* \class ASTEncoder
+* Builds the records of a tree, children first. Each visit comes
+* once a node's children have their records, adds the node's own,
+* and returns the record's index (1-based; 0 stands for no node).
+* Fields are written in the order ASTDecoder::record reads them.
+**/
+class ASTEncoder : public ASTFolder<ASTEncoder, uint32_t>{
+public:
+	uint32_t add(ASTNode * node){
+		return node == nullptr ? 0 : fold(node);
+	}
+
+	/* A function's return type is recorded ahead of its name */
+	template <typename F>
+	void children(ASTNode * node, F f){
+		if (node->kind() != NodeKind::FN_DECL){
+			forEachChild(node, f);
+			return;
+		}
+		FnDeclNode * fn = static_cast<FnDeclNode *>(node);
+		f(fn->getType());
+		f(fn->getID());
+		for (auto formal : *fn->getDecls()){ f(formal); }
+		for (auto stmt : *fn->getStmts()){ f(stmt); }
+	}
+
+	uint32_t visitProgram(ProgramNode * node){
+		// The span is worked out again from the globals on load
+		std::vector<uint32_t> globals = childList(node->globals());
+		uint32_t self = begin(node->kind(), nullptr);
+		indices(globals);
+		return self;
+	}
+
+	uint32_t visitVarDecl(VarDeclNode * node){
+		uint32_t id = child(node->getID());
+		uint32_t type = child(node->getType());
+		uint32_t init = child(node->getExp());
+		uint32_t self = begin(node);
+		index(id);
+		index(type);
+		index(init);
+		return self;
+	}
+
+	uint32_t visitFormalDecl(FormalDeclNode * node){
+		uint32_t id = child(node->getID());
+		uint32_t type = child(node->getType());
+		uint32_t self = begin(node);
+		index(id);
+		index(type);
+		return self;
+	}
+
+	uint32_t visitFnDecl(FnDeclNode * node){
+		uint32_t type = child(node->getType());
+		uint32_t id = child(node->getID());
+		std::vector<uint32_t> formals = childList(node->getDecls());
+		std::vector<uint32_t> body = childList(node->getStmts());
+		uint32_t self = begin(node);
+		index(type);
+		index(id);
+		indices(formals);
+		indices(body);
+		return self;
+	}
+
+	uint32_t visitClassDecl(ClassDeclNode * node){
+		uint32_t name = child(node->getName());
+		std::vector<uint32_t> members = childList(node->getDecls());
+		uint32_t self = begin(node);
+		index(name);
+		indices(members);
+		return self;
+	}
+
+	uint32_t visitClassType(ClassTypeNode * node){
+		return unary(node, node->getID());
+	}
+
+	uint32_t visitPerfectType(PerfectTypeNode * node){
+		return unary(node, node->getType());
+	}
+
+	uint32_t visitAssign(AssignStmtNode * node){
+		uint32_t dest = child(node->getDest());
+		uint32_t exp = child(node->getExp());
+		uint32_t self = begin(node);
+		index(dest);
+		index(exp);
+		return self;
+	}
+
+	uint32_t visitCallStmt(CallStmtNode * node){
+		return unary(node, node->getCall());
+	}
+
+	uint32_t visitGive(GiveStmtNode * node){
+		return unary(node, node->getExp());
+	}
+
+	uint32_t visitIfElse(IfElseStmtNode * node){
+		uint32_t cond = child(node->getCondition());
+		std::vector<uint32_t> yes = childList(node->getTrueBranch());
+		std::vector<uint32_t> no = childList(node->getFalseBranch());
+		uint32_t self = begin(node);
+		index(cond);
+		indices(yes);
+		indices(no);
+		return self;
+	}
+
+	uint32_t visitIf(IfStmtNode * node){
+		return loop(node, node->getCondition(), node->getStmts());
+	}
+
+	uint32_t visitWhile(WhileStmtNode * node){
+		return loop(node, node->getExp(), node->getStmts());
+	}
+
+	uint32_t visitPostDec(PostDecStmtNode * node){
+		return unary(node, node->getLoc());
+	}
+
+	uint32_t visitPostInc(PostIncStmtNode * node){
+		return unary(node, node->getLoc());
+	}
+
+	uint32_t visitReturn(ReturnStmtNode * node){
+		return unary(node, node->getExp());
+	}
+
+	uint32_t visitTake(TakeStmtNode * node){
+		return unary(node, node->getLoc());
+	}
+
+	uint32_t visitCallExp(CallExpNode * node){
+		uint32_t name = child(node->getFunctionName());
+		std::vector<uint32_t> actuals = childList(node->getArgs());
+		uint32_t self = begin(node);
+		index(name);
+		indices(actuals);
+		return self;
+	}
+
+	uint32_t visitIntLit(IntLitNode * node){
+		uint32_t self = begin(node);
+		varint(zigzag(node->getValue()));
+		return self;
+	}
+
+	uint32_t visitStrLit(StrLitNode * node){
+		uint32_t self = begin(node);
+		string(node->getStr());
+		return self;
+	}
+
+	uint32_t visitID(IDNode * node){
+		uint32_t self = begin(node);
+		string(node->getName());
+		return self;
+	}
+
+	uint32_t visitMemberField(MemberFieldExpNode * node){
+		uint32_t loc = child(node->getLoc());
+		uint32_t name = child(node->getName());
+		uint32_t self = begin(node);
+		index(loc);
+		index(name);
+		return self;
+	}
+
+	uint32_t visitUnaryExp(UnaryExpNode * node){
+		return unary(node, node->getExp());
+	}
+
+	uint32_t visitBinaryExp(BinaryExpNode * node){
+		uint32_t lhs = child(node->getLhs());
+		uint32_t rhs = child(node->getRhs());
+		uint32_t self = begin(node);
+		index(lhs);
+		index(rhs);
+		return self;
+	}
+
+	/* Types, exit, and the constants are only a kind and a span */
+	uint32_t visitNode(ASTNode * node){
+		return begin(node);
+	}
+
+	/** The whole file, once the root has been added **/
+	void write(Writer& out) const{
+		/* The header and string table, built with a second encoder's
+		   varint so both halves share one encoding */
+		ASTEncoder head;
+		head.myNodes.append(MAGIC, MAGIC_LEN);
+		head.varint(myStrings.size());
+		const Interner& strings = Interner::global();
+		for (StrHandle str : myStrings){
+			head.varint(strings.length(str));
+			head.myNodes.append(strings.chars(str), strings.length(str));
+		}
+		head.varint(myCount);
+		out.write(head.myNodes.data(), head.myNodes.size());
+		out.write(myNodes.data(), myNodes.size());
+	}
+private:
+	uint32_t unary(ASTNode * node, ASTNode * operand){
+		uint32_t index = child(operand);
+		uint32_t self = begin(node);
+		this->index(index);
+		return self;
+	}
+
+	uint32_t loop(ASTNode * node, ExpNode * cond,
+	  const NodeList<StmtNode *> * body){
+		uint32_t condIndex = child(cond);
+		std::vector<uint32_t> stmts = childList(body);
+		uint32_t self = begin(node);
+		index(condIndex);
+		indices(stmts);
+		return self;
+	}
+
+	/* Start the record of a node whose children are all added */
+	uint32_t begin(ASTNode * node){
+		return begin(node->kind(), node->pos());
+	}
+
+	uint32_t begin(NodeKind kind, const Position * pos){
+		myCount++;
+		uint8_t tag = static_cast<uint8_t>(kind);
+		if (pos == nullptr){
+			myNodes += static_cast<char>(tag | NO_POSITION);
+			return myCount;
+		}
+		myNodes += static_cast<char>(tag);
+		varint(zigzag(difference(pos->lineBegin(), myLastLine)));
+		varint(pos->colBegin());
+		varint(zigzag(difference(pos->lineEnd(), pos->lineBegin())));
+		varint(zigzag(difference(pos->colEnd(), pos->colBegin())));
+		myLastLine = pos->lineBegin();
+		return myCount;
+	}
+
+	void index(uint32_t i){
+		// Relative to this record, which is the one just begun
+		varint(i == 0 ? 0 : myCount - i);
+	}
+
+	void indices(const std::vector<uint32_t>& list){
+		varint(list.size());
+		for (uint32_t i : list){ index(i); }
+	}
+
+	void string(StrHandle str){
+		auto found = myStringIndex.find(str);
+		if (found != myStringIndex.end()){
+			varint(found->second);
+			return;
+		}
+		uint32_t index = static_cast<uint32_t>(myStrings.size());
+		myStringIndex[str] = index;
+		myStrings.push_back(str);
+		varint(index);
+	}
+
+	void varint(uint64_t value){
+		while (value >= 0x80){
+			myNodes += static_cast<char>((value & 0x7f) | 0x80);
+			value >>= 7;
+		}
+		myNodes += static_cast<char>(value);
+	}
+
+	std::string myNodes;
+	uint32_t myCount = 0;
+	size_t myLastLine = 0;
+	std::unordered_map<StrHandle, uint32_t> myStringIndex;
+	std::vector<StrHandle> myStrings;
+};
+
+void writeAST(ProgramNode * root, Writer& out){
+	ASTEncoder encoder;
+	encoder.add(root);
+	encoder.write(out);
+}
+
+/**
+* \class ASTDecoder
+* Reads an AST file back into nodes, checking every index, kind and
+* length against what the format allows before it is used.
+**/
+class ASTDecoder{
+public:
+	ASTDecoder(const char * data, size_t len, Arena& arena)
+	: myCur(data), myEnd(data + len), myArena(arena){ }
+
+	ProgramNode * read(){
+		if (static_cast<size_t>(myEnd - myCur) < MAGIC_LEN
+		    || memcmp(myCur, MAGIC, MAGIC_LEN) != 0){
+			bad("not an AST file");
+		}
+		myCur += MAGIC_LEN;
+		Interner& strings = Interner::global();
+		size_t stringCount = count();
+		for (size_t i = 0; i < stringCount; i++){
+			size_t len = count();
+			if (static_cast<size_t>(myEnd - myCur) < len){
+				bad("string runs past the end");
+			}
+			myStrings.push_back(strings.intern(myCur, len));
+			myCur += len;
+		}
+		size_t nodeCount = count();
+		myNodes.reserve(nodeCount);
+		for (size_t i = 0; i < nodeCount; i++){
+			if (myCur == myEnd){ bad("record runs past the end"); }
+			uint8_t tag = static_cast<uint8_t>(*myCur++);
+			NodeKind kind = static_cast<NodeKind>(tag & ~NO_POSITION);
+			Position span;
+			const Position * pos = nullptr;
+			if ((tag & NO_POSITION) == 0){
+				span = position();
+				pos = &span;
+			}
+			myChildren.clear();
+			ASTNode * made = record(kind, pos);
+			adopt();
+			myNodes.push_back(made);
+		}
+		if (myCur != myEnd){ bad("data after the last record"); }
+		if (myUnused.size() > 1){ bad("record that no node uses"); }
+		ProgramNode * root = myNodes.empty() ? nullptr
+		  : fits<ProgramNode>(myNodes.back());
+		if (root == nullptr){ bad("the last record is not a program"); }
+		return root;
+	}
+private:
+	[[noreturn]] void bad(const char * why){
+		std::string msg = "Bad AST file: ";
+		msg += why;
+		throw new UserError(msg.c_str());
+	}
+
+	uint64_t varint(){
+		uint64_t value = 0;
+		for (unsigned shift = 0; shift < 64; shift += 7){
+			if (myCur == myEnd){ bad("number runs past the end"); }
+			uint8_t byte = static_cast<uint8_t>(*myCur++);
+			value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+			if ((byte & 0x80) == 0){ return value; }
+		}
+		bad("number too long");
+	}
+
+	/* A count or length, which can't be more than the bytes left */
+	size_t count(){
+		uint64_t value = varint();
+		if (value > static_cast<uint64_t>(myEnd - myCur)){
+			bad("count larger than the file");
+		}
+		return static_cast<size_t>(value);
+	}
+
+	Position position(){
+		int64_t line = field(myLastLine, unzigzag(varint()));
+		int64_t col = field(0, static_cast<int64_t>(varint()));
+		int64_t lineEnd = field(line, unzigzag(varint()));
+		int64_t colEnd = field(col, unzigzag(varint()));
+		myLastLine = line;
+		return Position(static_cast<size_t>(line),
+		  static_cast<size_t>(col), static_cast<size_t>(lineEnd),
+		  static_cast<size_t>(colEnd));
+	}
+
+	/* base + delta, if that fits in a position field */
+	int64_t field(int64_t base, int64_t delta){
+		if (delta < -base || delta > int64_t(UINT32_MAX) - base){
+			bad("position out of range");
+		}
+		return base + delta;
+	}
+
+	/* An earlier record, which must be a T; none only if 
+	   optional */
+	template <typename T>
+	T * node(bool optional = false){
+		uint64_t back = varint();
+		if (back == 0 && optional){ return nullptr; }
+		if (back == 0 || back > myNodes.size()){
+			bad("child index out of range");
+		}
+		size_t index = myNodes.size() - back;
+		T * child = fits<T>(myNodes[index]);
+		if (child == nullptr){ bad("child of the wrong kind"); }
+		myChildren.push_back(index);
+		return child;
+	}
+
+	/* In post-order a record's children are, in order, the latest
+	   records no earlier record has taken as a child. Take them,
+	   leaving the record itself to be taken by its parent, so each
+	   record has exactly one parent and the decoded tree can't
+	   share (or blow up into) subtrees. */
+	void adopt(){
+		if (myChildren.size() > myUnused.size()){
+			bad("child used twice");
+		}
+		size_t base = myUnused.size() - myChildren.size();
+		for (size_t i = 0; i < myChildren.size(); i++){
+			if (myUnused[base + i] != myChildren[i]){
+				bad("child used twice or out of order");
+			}
+		}
+		myUnused.resize(base);
+		myUnused.push_back(myNodes.size());
+	}
+
+	/* node as a T, or null if its kind isn't one of T's */
+	template <typename T>
+	static T * fits(ASTNode * node){
+		return accepts(node->kind(), static_cast<T *>(nullptr))
+		  ? static_cast<T *>(node) : nullptr;
+	}
+
+	static bool accepts(NodeKind kind, ProgramNode *){
+		return kind == NodeKind::PROGRAM;
+	}
+	static bool accepts(NodeKind kind, IDNode *){
+		return kind == NodeKind::ID;
+	}
+	static bool accepts(NodeKind kind, CallExpNode *){
+		return kind == NodeKind::CALL_EXP;
+	}
+	static bool accepts(NodeKind kind, FormalDeclNode *){
+		return kind == NodeKind::FORMAL_DECL;
+	}
+	static bool accepts(NodeKind kind, LocNode *){ return isLoc(kind); }
+	static bool accepts(NodeKind kind, ExpNode *){ return isExp(kind); }
+	static bool accepts(NodeKind kind, TypeNode *){ return isType(kind); }
+	static bool accepts(NodeKind kind, StmtNode *){ return isStmt(kind); }
+	static bool accepts(NodeKind kind, DeclNode *){ return isDecl(kind); }
+
+	template <typename T>
+	NodeList<T *> * list(){
+		NodeList<T *> * result = myArena.make<NodeList<T *>>(myArena);
+		size_t length = count();
+		for (size_t i = 0; i < length; i++){
+			result->push_back(node<T>());
+		}
+		return result;
+	}
+
+	int integer(){
+		int64_t value = unzigzag(varint());
+		if (value < INT32_MIN || value > INT32_MAX){
+			bad("integer out of range");
+		}
+		return static_cast<int>(value);
+	}
+
+	StrHandle string(){
+		uint64_t index = varint();
+		if (index >= myStrings.size()){ bad("string index out of range"); }
+		return myStrings[index];
+	}
+
+	template <typename T>
+	ASTNode * unaryNode(const Position& pos){
+		ExpNode * exp = node<ExpNode>();
+		return myArena.make<T>(pos, exp);
+	}
+
+	template <typename T>
+	ASTNode * binaryNode(const Position& pos){
+		ExpNode * lhs = node<ExpNode>();
+		ExpNode * rhs = node<ExpNode>();
+		return myArena.make<T>(pos, lhs, rhs);
+	}
+
+	/* Fields are read into locals first, since the order in which
+	   a call's arguments are evaluated is unspecified */
+	ASTNode * record(NodeKind kind, const Position * pos){
+		if (pos == nullptr && kind != NodeKind::PROGRAM){
+			bad("node without a position");
+		}
+		switch (kind){
+		case NodeKind::PROGRAM: {
+			NodeList<DeclNode *> * globals = list<DeclNode>();
+			return myArena.make<ProgramNode>(globals);
+		}
+		case NodeKind::VAR_DECL: {
+			IDNode * id = node<IDNode>();
+			TypeNode * type = node<TypeNode>();
+			ExpNode * init = node<ExpNode>(true);
+			return myArena.make<VarDeclNode>(*pos, id, type, init);
+		}
+		case NodeKind::FORMAL_DECL: {
+			IDNode * id = node<IDNode>();
+			TypeNode * type = node<TypeNode>();
+			return myArena.make<FormalDeclNode>(*pos, id, type);
+		}
+		case NodeKind::FN_DECL: {
+			TypeNode * type = node<TypeNode>();
+			IDNode * id = node<IDNode>();
+			NodeList<FormalDeclNode *> * formals = list<FormalDeclNode>();
+			NodeList<StmtNode *> * body = list<StmtNode>();
+			return myArena.make<FnDeclNode>(*pos, type, id, formals, body);
+		}
+		case NodeKind::CLASS_DECL: {
+			IDNode * id = node<IDNode>();
+			NodeList<DeclNode *> * members = list<DeclNode>();
+			return myArena.make<ClassDeclNode>(*pos, id, members);
+		}
+		case NodeKind::INT_TYPE: return myArena.make<IntTypeNode>(*pos);
+		case NodeKind::BOOL_TYPE: return myArena.make<BoolTypeNode>(*pos);
+		case NodeKind::VOID_TYPE: return myArena.make<VoidTypeNode>(*pos);
+		case NodeKind::CLASS_TYPE: {
+			IDNode * id = node<IDNode>();
+			return myArena.make<ClassTypeNode>(*pos, id);
+		}
+		case NodeKind::PERFECT_TYPE: {
+			TypeNode * type = node<TypeNode>();
+			return myArena.make<PerfectTypeNode>(*pos, type);
+		}
+		case NodeKind::ASSIGN: {
+			LocNode * dest = node<LocNode>();
+			ExpNode * exp = node<ExpNode>();
+			return myArena.make<AssignStmtNode>(*pos, dest, exp);
+		}
+		case NodeKind::CALL_STMT: {
+			CallExpNode * call = node<CallExpNode>();
+			return myArena.make<CallStmtNode>(*pos, call);
+		}
+		case NodeKind::EXIT: return myArena.make<ExitStmtNode>(*pos);
+		case NodeKind::GIVE: return unaryNode<GiveStmtNode>(*pos);
+		case NodeKind::IF_ELSE: {
+			ExpNode * cond = node<ExpNode>();
+			NodeList<StmtNode *> * yes = list<StmtNode>();
+			NodeList<StmtNode *> * no = list<StmtNode>();
+			return myArena.make<IfElseStmtNode>(*pos, cond, yes, no);
+		}
+		case NodeKind::IF: {
+			ExpNode * cond = node<ExpNode>();
+			NodeList<StmtNode *> * body = list<StmtNode>();
+			return myArena.make<IfStmtNode>(*pos, cond, body);
+		}
+		case NodeKind::POST_DEC: {
+			LocNode * loc = node<LocNode>();
+			return myArena.make<PostDecStmtNode>(*pos, loc);
+		}
+		case NodeKind::POST_INC: {
+			LocNode * loc = node<LocNode>();
+			return myArena.make<PostIncStmtNode>(*pos, loc);
+		}
+		case NodeKind::RETURN: {
+			ExpNode * exp = node<ExpNode>(true);
+			return myArena.make<ReturnStmtNode>(*pos, exp);
+		}
+		case NodeKind::TAKE: {
+			LocNode * loc = node<LocNode>();
+			return myArena.make<TakeStmtNode>(*pos, loc);
+		}
+		case NodeKind::WHILE: {
+			ExpNode * cond = node<ExpNode>();
+			NodeList<StmtNode *> * body = list<StmtNode>();
+			return myArena.make<WhileStmtNode>(*pos, cond, body);
+		}
+		case NodeKind::CALL_EXP: {
+			LocNode * name = node<LocNode>();
+			NodeList<ExpNode *> * args = list<ExpNode>();
+			return myArena.make<CallExpNode>(*pos, name, args);
+		}
+		case NodeKind::FALSE_LIT: return myArena.make<FalseNode>(*pos);
+		case NodeKind::TRUE_LIT: return myArena.make<TrueNode>(*pos);
+		case NodeKind::MAGIC: return myArena.make<MagicNode>(*pos);
+		case NodeKind::INT_LIT: {
+			int value = integer();
+			return myArena.make<IntLitNode>(*pos, value);
+		}
+		case NodeKind::STR_LIT: {
+			StrHandle str = string();
+			return myArena.make<StrLitNode>(*pos, str);
+		}
+		case NodeKind::ID: {
+			StrHandle name = string();
+			return myArena.make<IDNode>(*pos, name);
+		}
+		case NodeKind::MEMBER_FIELD: {
+			LocNode * loc = node<LocNode>();
+			IDNode * name = node<IDNode>();
+			return myArena.make<MemberFieldExpNode>(*pos, loc, name);
+		}
+		case NodeKind::NEG: return unaryNode<NegNode>(*pos);
+		case NodeKind::NOT: return unaryNode<NotNode>(*pos);
+		case NodeKind::AND: return binaryNode<AndNode>(*pos);
+		case NodeKind::DIVIDE: return binaryNode<DivideNode>(*pos);
+		case NodeKind::EQUALS: return binaryNode<EqualsNode>(*pos);
+		case NodeKind::GREATER_EQ: return binaryNode<GreaterEqNode>(*pos);
+		case NodeKind::GREATER: return binaryNode<GreaterNode>(*pos);
+		case NodeKind::LESS: return binaryNode<LessNode>(*pos);
+		case NodeKind::LESS_EQ: return binaryNode<LessEqNode>(*pos);
+		case NodeKind::MINUS: return binaryNode<MinusNode>(*pos);
+		case NodeKind::NOT_EQUALS: return binaryNode<NotEqualsNode>(*pos);
+		case NodeKind::OR: return binaryNode<OrNode>(*pos);
+		case NodeKind::PLUS: return binaryNode<PlusNode>(*pos);
+		case NodeKind::TIMES: return binaryNode<TimesNode>(*pos);
+		}
+		bad("unknown node kind");
+	}
+
+	const char * myCur;
+	const char * myEnd;
+	Arena& myArena;
+	int64_t myLastLine = 0;
+	std::vector<StrHandle> myStrings;
+	std::vector<ASTNode *> myNodes;
+	/* Records not yet taken as a child, oldest first */
+	std::vector<size_t> myUnused;
+	/* The records the current record has taken as children */
+	std::vector<size_t> myChildren;
+};
+
+ProgramNode * readAST(const char * data, size_t len, Arena& arena){
+	return ASTDecoder(data, len, arena).read();
+}
+
+}
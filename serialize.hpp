@@ -0,0 +1,38 @@
+#ifndef DREWNO_MARS_SERIALIZE_H
+#define DREWNO_MARS_SERIALIZE_H
+
+#include "arena.hpp"
+#include "ast.hpp"
+#include "writer.hpp"
+
+namespace drewno_mars{
+
+/*
+An AST file is laid out as
+
+    magic "dmc-ast 2\n"
+    string count, then each string as length and bytes
+    node count, then each node record
+
+with every number written as a LEB128 varint. Records come in
+post-order, so a node's children always precede it and the last
+record is the root; every other record is the child of exactly one
+later record, which must name its children in the order they come. A record is its NodeKind byte (with the high
+bit set if it has no position), its position, and its fields. The
+position is packed as deltas: its first line from the previous
+record's, then its first column, then its end from its start.
+A child is given as how many records back it is (0 for none), a
+list as a count and children, and a string as its index in the
+string table; signed numbers are zigzag-encoded.
+*/
+
+/** Write the tree rooted at root in the binary AST format **/
+void writeAST(ProgramNode * root, Writer& out);
+
+/** Rebuild a tree from an AST file's contents, with its nodes in
+    arena. Throws a UserError if data isn't a well-formed AST. **/
+ProgramNode * readAST(const char * data, size_t len, Arena& arena);
+
+}
+
+#endif
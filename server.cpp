@@ -0,0 +1,387 @@
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <exception>
+#include <sstream>
+#include <thread>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "server.hpp"
+#include "hash.hpp"
+
+namespace drewno_mars{
+
+/* Requests naming longer paths are refused */
+static const size_t MAX_PATH_LENGTH = 64 * 1024;
+/* Files kept compiled at once; past this the one used least
+   recently is dropped */
+static const size_t MAX_ENTRIES = 1024;
+
+struct CompileServer::Entry{
+	/* What the file looked like when it was compiled */
+	struct timespec mtime;
+	off_t size;
+	uint64_t hash;
+	/* When it was last asked for, in lookups */
+	uint64_t lastUsed = 0;
+	DiagnosticEngine diags;
+	std::unique_ptr<Compilation> comp;
+};
+
+/* Buffered reads of request frames from a file descriptor */
+class FrameReader{
+public:
+	explicit FrameReader(int fd) : myFd(fd){ }
+
+	/** The next line, without its newline; false at the end **/
+	bool line(std::string& text){
+		text.clear();
+		for (;;){
+			if (myPos == myLen && !fill()){ return false; }
+			const char * start = myBuf + myPos;
+			const void * nl = memchr(start, '\n', myLen - myPos);
+			if (nl != nullptr){
+				size_t len = static_cast<size_t>(
+				  static_cast<const char *>(nl) - start);
+				text.append(start, len);
+				myPos += len + 1;
+				return true;
+			}
+			text.append(start, myLen - myPos);
+			myPos = myLen;
+			if (text.size() > MAX_PATH_LENGTH){ return false; }
+		}
+	}
+
+	/** Exactly count bytes; false if the input ends first **/
+	bool bytes(size_t count, std::string& text){
+		text.clear();
+		while (text.size() < count){
+			if (myPos == myLen && !fill()){ return false; }
+			size_t take = std::min(count - text.size(), myLen - myPos);
+			text.append(myBuf + myPos, take);
+			myPos += take;
+		}
+		return true;
+	}
+private:
+	bool fill(){
+		for (;;){
+			ssize_t n = ::read(myFd, myBuf, sizeof(myBuf));
+			if (n < 0 && errno == EINTR){ continue; }
+			if (n <= 0){ return false; }
+			myPos = 0;
+			myLen = static_cast<size_t>(n);
+			return true;
+		}
+	}
+
+	int myFd;
+	char myBuf[64 * 1024];
+	size_t myPos = 0;
+	size_t myLen = 0;
+};
+
+static bool writeAll(int fd, const std::string& text){
+	const char * p = text.data();
+	size_t left = text.size();
+	while (left > 0){
+		ssize_t n = ::write(fd, p, left);
+		if (n < 0){
+			if (errno == EINTR){ continue; }
+			return false;
+		}
+		p += n;
+		left -= static_cast<size_t>(n);
+	}
+	return true;
+}
+
+static bool respond(int fd, bool ok, const std::string& out,
+  const std::string& err){
+	std::string frame = ok ? "ok " : "fail ";
+	frame += std::to_string(out.size()) + " "
+	  + std::to_string(err.size()) + "\n";
+	frame += out;
+	frame += err;
+	return writeAll(fd, frame);
+}
+
+/* True if path names a socket (and not, say, a mistyped source
+   file), so that it is safe to unlink */
+static bool isSocket(const char * path){
+	struct stat info;
+	return lstat(path, &info) == 0 && S_ISSOCK(info.st_mode);
+}
+
+static bool sameTime(const struct timespec& a, const struct timespec& b){
+	return a.tv_sec == b.tv_sec && a.tv_nsec == b.tv_nsec;
+}
+
+CompileServer::CompileServer(ScannerKind scanner, size_t maxErrors,
+  size_t depthLimit)
+: myScanner(scanner), myMaxErrors(maxErrors), myDepthLimit(depthLimit),
+  myHits(0), myMisses(0),
+  myStopping(false), myListenFd(-1){
+}
+
+CompileServer::~CompileServer(){ }
+
+std::shared_ptr<CompileServer::Entry> CompileServer::lookup(
+  const std::string& path){
+	struct stat info;
+	if (stat(path.c_str(), &info) != 0){
+		std::lock_guard<std::mutex> guard(myLock);
+		myCache.erase(path);
+		std::string msg = "Bad input stream " + path;
+		throw new UserError(msg.c_str());
+	}
+
+	std::shared_ptr<Entry> cached;
+	{
+		std::lock_guard<std::mutex> guard(myLock);
+		auto found = myCache.find(path);
+		if (found != myCache.end()){ cached = found->second; }
+		if (cached && sameTime(cached->mtime, info.st_mtim)
+		    && cached->size == info.st_size){
+			cached->lastUsed = ++myClock;
+			myHits++;
+			return cached;
+		}
+	}
+
+	/* The hash is taken from the very text that is compiled, so
+	   an entry never pairs one version's hash with another's AST */
+	std::shared_ptr<Entry> entry(new Entry());
+	entry->mtime = info.st_mtim;
+	entry->size = info.st_size;
+	entry->diags.setLimit(myMaxErrors);
+	entry->comp.reset(new Compilation(path.c_str(), entry->diags,
+	  myScanner));
+	const SourceBuffer& source = entry->comp->source();
+	entry->hash = contentHash(source.data(), source.size());
+
+	/* Touched, but maybe not changed */
+	if (cached && cached->hash == entry->hash){
+		std::lock_guard<std::mutex> guard(myLock);
+		cached->mtime = info.st_mtim;
+		cached->size = info.st_size;
+		cached->lastUsed = ++myClock;
+		myHits++;
+		return cached;
+	}
+
+	entry->comp->setDepthLimit(myDepthLimit);
+	entry->comp->run(true, true);
+	entry->comp->release();
+	myMisses++;
+
+	std::lock_guard<std::mutex> guard(myLock);
+	entry->lastUsed = ++myClock;
+	myCache[path] = entry;
+	if (myCache.size() > MAX_ENTRIES){
+		/* Requests still using the dropped entry keep it alive */
+		auto oldest = myCache.begin();
+		for (auto it = myCache.begin(); it != myCache.end(); ++it){
+			if (it->second->lastUsed < oldest->second->lastUsed){
+				oldest = it;
+			}
+		}
+		myCache.erase(oldest);
+	}
+	return entry;
+}
+
+bool CompileServer::handle(const std::string& command,
+  const std::string& path, std::string& out, std::string& err){
+	if (command == "stats"){
+		std::lock_guard<std::mutex> guard(myLock);
+		out = "hits " + std::to_string(myHits) + "\n"
+		  + "misses " + std::to_string(myMisses) + "\n"
+		  + "entries " + std::to_string(myCache.size()) + "\n";
+		return true;
+	}
+	if (command != "tokens" && command != "parse-check"
+	    && command != "unparse"){
+		err = "Unknown command " + command + "\n";
+		return false;
+	}
+
+	std::shared_ptr<Entry> entry = lookup(path);
+	const Compilation& comp = *entry->comp;
+	/* The cached diagnostics are shared, so flush a copy. A token
+	   dump doesn't parse, so it leaves out the syntax errors. */
+	DiagnosticEngine diags(myMaxErrors);
+	for (const Diagnostic& diag : entry->diags.diagnostics()){
+		if (command == "tokens" && diag.severity == Severity::ERROR){
+			continue;
+		}
+		diags.report(diag.severity, diag.id, diag.span,
+		  entry->diags.arg(diag));
+	}
+	bool ok = true;
+	std::ostringstream outStream;
+	{
+		Writer writer(outStream);
+		if (command == "tokens"){
+			comp.writeTokens(writer);
+		} else if (!comp.parsed()){
+			DiagID why = command == "unparse"
+			  ? DiagID::NO_AST : DiagID::PARSE_FAILED;
+			diags.note(why);
+			ok = false;
+		} else if (command == "unparse"){
+			ASTNode * ast = comp.ast();
+			ast->unparse(writer, 0);
+		}
+		writer.flush();
+	}
+	std::ostringstream errStream;
+	diags.flush(errStream, errStream);
+	out = outStream.str();
+	err = errStream.str();
+	return ok;
+}
+
+void CompileServer::serve(int inFd, int outFd){
+	FrameReader reader(inFd);
+	std::string header;
+	std::string path;
+	while (!myStopping && reader.line(header)){
+		std::istringstream fields(header);
+		std::string command;
+		size_t length;
+		if (!(fields >> command >> length) || length > MAX_PATH_LENGTH){
+			respond(outFd, false, "", "Bad request: " + header + "\n");
+			return;
+		}
+		if (!reader.bytes(length, path)){ return; }
+
+		if (command == "shutdown"){
+			stop();
+			respond(outFd, true, "", "");
+			return;
+		}
+
+		std::string out;
+		std::string err;
+		bool ok = false;
+		JobSlot slot(*this);
+		try {
+			ok = handle(command, path, out, err);
+		} catch (ToDoError * e){
+			err = std::string("ToDo: ") + e->msg() + "\n";
+			delete e;
+		} catch (InternalError * e){
+			err = "Something in the compiler is broken: " + e->msg() + "\n";
+			delete e;
+		} catch (UserError * e){
+			err = "The user made a mistake: " + e->msg() + "\n";
+			delete e;
+		} catch (std::exception& e){
+			// Answered like any other failure, not left to end the server
+			err = std::string("Something in the compiler is broken: ")
+			  + e.what() + "\n";
+		} catch (...){
+			err = "Something in the compiler is broken\n";
+		}
+		if (!respond(outFd, ok, out, err)){ return; }
+	}
+}
+
+CompileServer::JobSlot::JobSlot(CompileServer& server) : myServer(server){
+	std::unique_lock<std::mutex> lock(myServer.myJobLock);
+	myServer.myJobFree.wait(lock, [this](){
+		return myServer.myJobs == 0 || myServer.myRunning < myServer.myJobs;
+	});
+	myServer.myRunning++;
+}
+
+CompileServer::JobSlot::~JobSlot(){
+	std::lock_guard<std::mutex> guard(myServer.myJobLock);
+	myServer.myRunning--;
+	myServer.myJobFree.notify_one();
+}
+
+void CompileServer::stop(){
+	myStopping = true;
+	int listenFd = myListenFd;
+	// Wakes up the accept() in listen()
+	if (listenFd >= 0){ ::shutdown(listenFd, SHUT_RDWR); }
+	/* Idle clients would hold the server up forever; their next
+	   read ends instead, while answers in progress still go out */
+	std::lock_guard<std::mutex> guard(myConnLock);
+	for (int conn : myConnections){ ::shutdown(conn, SHUT_RD); }
+}
+
+void CompileServer::listen(const char * path, size_t jobs){
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(addr.sun_path)){
+		std::string msg = "Socket path too long: ";
+		msg += path;
+		throw new UserError(msg.c_str());
+	}
+	strcpy(addr.sun_path, path);
+
+	/* A socket left behind by an earlier server is replaced, but
+	   anything else at path is the user's */
+	struct stat info;
+	if (lstat(path, &info) == 0){
+		if (!S_ISSOCK(info.st_mode)){
+			std::string msg = "Not a socket, won't replace: ";
+			msg += path;
+			throw new UserError(msg.c_str());
+		}
+		unlink(path);
+	}
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0 || bind(fd, reinterpret_cast<struct sockaddr *>(&addr),
+	      sizeof(addr)) != 0 || ::listen(fd, 64) != 0){
+		if (fd >= 0){ close(fd); }
+		std::string msg = "Can't listen on ";
+		msg += path;
+		throw new UserError(msg.c_str());
+	}
+	// A client hanging up mid-response shouldn't end the server
+	signal(SIGPIPE, SIG_IGN);
+	myListenFd = fd;
+	myJobs = jobs;
+
+	/* Each connection gets a thread of its own, so that clients
+	   that stay connected can't starve the others, and at most
+	   jobs of them compile at once */
+	while (!myStopping){
+		int conn = accept(fd, nullptr, nullptr);
+		if (conn < 0){
+			if (errno == EINTR || errno == ECONNABORTED){ continue; }
+			break;
+		}
+		std::lock_guard<std::mutex> guard(myConnLock);
+		if (myStopping){
+			close(conn);
+			break;
+		}
+		myConnections.insert(conn);
+		std::thread([this, conn](){
+			serve(conn, conn);
+			std::lock_guard<std::mutex> done(myConnLock);
+			myConnections.erase(conn);
+			close(conn);
+			myConnDone.notify_all();
+		}).detach();
+	}
+	{
+		std::unique_lock<std::mutex> lock(myConnLock);
+		myConnDone.wait(lock, [this](){ return myConnections.empty(); });
+	}
+	myListenFd = -1;
+	close(fd);
+	if (isSocket(path)){ unlink(path); }
+}
+
+}
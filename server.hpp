@@ -0,0 +1,106 @@
+#ifndef DREWNO_MARS_SERVER_H
+#define DREWNO_MARS_SERVER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include "compilation.hpp"
+
+namespace drewno_mars{
+
+/**
+* \class CompileServer
+* A long-lived dmc that answers compile requests from memory. Each
+* file's Compilation (tokens, diagnostics and AST) is kept after
+* the first request. It is reused while the file's mtime and size
+* are unchanged, or, if those moved, while its contents still hash
+* the same. At most a fixed number of files are kept, dropping the
+* one used least recently, and a file that can no longer be read is
+* dropped at once.
+*
+* The protocol is a sequence of frames on one byte stream. A request
+* is a header line and the path it names:
+*
+*     <command> <pathLength>\n<path>
+*
+* where command is one of tokens, parse-check, unparse, stats or
+* shutdown. Every request gets one response:
+*
+*     <ok|fail> <outLength> <errLength>\n<out><err>
+*
+* out is what dmc would write to the -t or -u file (empty for
+* parse-check), and err holds the diagnostics it would print. stats
+* ignores its path and answers with the cache counters in out.
+**/
+class CompileServer{
+public:
+	CompileServer(ScannerKind scanner, size_t maxErrors,
+	  size_t depthLimit = DEFAULT_DEPTH_LIMIT);
+	~CompileServer();
+	CompileServer(const CompileServer&) = delete;
+	CompileServer& operator=(const CompileServer&) = delete;
+
+	/** Answer requests read from inFd on outFd until the input
+	    ends or a shutdown request arrives **/
+	void serve(int inFd, int outFd);
+
+	/** Accept connections on a Unix socket at path and serve each
+	    one on a thread of its own, compiling for at most jobs of
+	    them at once, until a shutdown request **/
+	void listen(const char * path, size_t jobs);
+
+	size_t hits() const { return myHits; }
+	size_t misses() const { return myMisses; }
+private:
+	struct Entry;
+
+	/* The cached entry for path, compiling it if it is new or
+	   has changed */
+	std::shared_ptr<Entry> lookup(const std::string& path);
+	/* Stop accepting, and end every connection after its current
+	   request */
+	void stop();
+	/* Run one command; returns false to fail the request */
+	bool handle(const std::string& command, const std::string& path,
+	  std::string& out, std::string& err);
+
+	const ScannerKind myScanner;
+	const size_t myMaxErrors;
+	const size_t myDepthLimit;
+	std::mutex myLock;
+	std::unordered_map<std::string, std::shared_ptr<Entry>> myCache;
+	uint64_t myClock = 0;
+	std::atomic<size_t> myHits;
+	std::atomic<size_t> myMisses;
+	std::atomic<bool> myStopping;
+	std::atomic<int> myListenFd;
+
+	/* Held while a request compiles, so that at most myJobs run at
+	   once (any number if it is 0) */
+	class JobSlot{
+	public:
+		explicit JobSlot(CompileServer& server);
+		~JobSlot();
+		JobSlot(const JobSlot&) = delete;
+		JobSlot& operator=(const JobSlot&) = delete;
+	private:
+		CompileServer& myServer;
+	};
+	std::mutex myJobLock;
+	std::condition_variable myJobFree;
+	size_t myJobs = 0;
+	size_t myRunning = 0;
+
+	/* The open connections in listen(), so stop() can end them */
+	std::mutex myConnLock;
+	std::condition_variable myConnDone;
+	std::set<int> myConnections;
+};
+
+}
+
+#endif
@@ -0,0 +1,70 @@
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "source.hpp"
+#include "errors.hpp"
+
+namespace drewno_mars{
+
+static void badInput(const std::string& path){
+	std::string msg = "Bad input stream ";
+	msg += path;
+	throw new UserError(msg.c_str());
+}
+
+SourceBuffer::SourceBuffer(const char * path) : myPath(path){
+	bool isStdin = strcmp(path, "-") == 0;
+	int fd = isStdin ? STDIN_FILENO : ::open(path, O_RDONLY);
+	if (fd < 0){ badInput(myPath); }
+
+	struct stat info;
+	if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode)
+	    && info.st_size > 0){
+		size_t len = static_cast<size_t>(info.st_size);
+		void * map = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (map != MAP_FAILED){
+			madvise(map, len, MADV_SEQUENTIAL);
+			myData = static_cast<const char *>(map);
+			mySize = len;
+			myMapped = true;
+		}
+	}
+	if (!myMapped){
+		try {
+			readAll(fd);
+		} catch (...) {
+			if (!isStdin){ ::close(fd); }
+			throw;
+		}
+	}
+	if (!isStdin){ ::close(fd); }
+}
+
+SourceBuffer::~SourceBuffer(){
+	if (myMapped){
+		munmap(const_cast<char *>(myData), mySize);
+	}
+}
+
+void SourceBuffer::readAll(int fd){
+	size_t used = 0;
+	myCopy.resize(64 * 1024);
+	while (true){
+		if (used == myCopy.size()){ myCopy.resize(myCopy.size() * 2); }
+		ssize_t got = ::read(fd, myCopy.data() + used, myCopy.size() - used);
+		if (got == 0){ break; }
+		if (got < 0){
+			if (errno == EINTR){ continue; }
+			badInput(myPath);
+		}
+		used += static_cast<size_t>(got);
+	}
+	myCopy.resize(used);
+	myData = myCopy.data();
+	mySize = used;
+}
+
+}
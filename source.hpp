@@ -0,0 +1,43 @@
+#ifndef DREWNO_MARS_SOURCE_H
+#define DREWNO_MARS_SOURCE_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace drewno_mars{
+
+/**
+* \class SourceBuffer
+* The complete, read-only text of one input. Regular files are 
+* memory-mapped so that the scanner reads the page cache directly;
+* anything that can't be mapped (pipes, terminals, stdin) is read
+* once, in large blocks, into a single heap buffer.
+**/
+class SourceBuffer{
+public:
+	/** Load the file at path, or stdin if path is "-". Throws a
+	    UserError if the input can't be opened or read **/
+	SourceBuffer(const char * path);
+	~SourceBuffer();
+	SourceBuffer(const SourceBuffer&) = delete;
+	SourceBuffer& operator=(const SourceBuffer&) = delete;
+
+	const char * data() const { return myData; }
+	size_t size() const { return mySize; }
+	const std::string& path() const { return myPath; }
+	/** True if data() points into a file mapping **/
+	bool mapped() const { return myMapped; }
+private:
+	void readAll(int fd);
+
+	std::string myPath;
+	const char * myData = nullptr;
+	size_t mySize = 0;
+	bool myMapped = false;
+	std::vector<char> myCopy;
+};
+
+}
+
+#endif
@@ -0,0 +1,297 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <time.h>
+#include <sys/resource.h>
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+#include "stats.hpp"
+#include "interner.hpp"
+#include "visitor.hpp"
+
+namespace drewno_mars{
+
+/* Wall seconds since the first call, so every trace starts near 0 */
+static double wallNow(){
+	using Clock = std::chrono::steady_clock;
+	static const Clock::time_point origin = Clock::now();
+	return std::chrono::duration<double>(Clock::now() - origin).count();
+}
+
+/* CPU seconds used by the calling thread, so that inputs compiled
+   side by side in batch mode are charged only for their own work */
+static double cpuNow(){
+	struct timespec now;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+	return static_cast<double>(now.tv_sec)
+	  + static_cast<double>(now.tv_nsec) / 1e9;
+}
+
+/* Bytes of heap the whole process has in use, where the C library
+   can say */
+static size_t heapInUse(){
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+	struct mallinfo2 info = mallinfo2();
+	return info.uordblks + info.hblkhd;
+#else
+	return 0;
+#endif
+}
+
+/* The process's high-water mark of resident memory, in bytes */
+static size_t peakRSS(){
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return static_cast<size_t>(usage.ru_maxrss) * 1024;
+}
+
+/* A small number for the calling thread, for the trace's tid */
+static unsigned threadNumber(){
+	static std::atomic<unsigned> next(1);
+	thread_local unsigned number = next++;
+	return number;
+}
+
+void Stats::Phase::begin(const char * name){
+	myIndex = myStats->myPhases.size();
+	Record record;
+	record.name = name;
+	record.thread = threadNumber();
+	record.wall = 0;
+	record.heap = 0;
+	record.peakRSS = 0;
+	record.arenaBytes = 0;
+	record.arenaReserved = 0;
+	record.cpu = cpuNow();
+	record.start = wallNow();
+	myStats->myPhases.push_back(record);
+}
+
+void Stats::Phase::end(){
+	Record& record = myStats->myPhases[myIndex];
+	record.wall = wallNow() - record.start;
+	record.cpu = cpuNow() - record.cpu;
+	if (myStats->myMemory){
+		const ArenaProfile& arena = myStats->myArenaProfile;
+		record.heap = heapInUse();
+		record.peakRSS = peakRSS();
+		record.arenaBytes = arena.bytes();
+		record.arenaReserved = arena.reserved();
+	}
+}
+
+void Stats::countTokens(const TokenBuffer& tokens){
+	for (size_t i = 0; i < tokens.size(); i++){
+		countToken(tokens.kind(i));
+	}
+	myTokenBytes += tokens.bytes();
+}
+
+void Stats::countToken(int kind){
+	size_t index = static_cast<size_t>(kind);
+	if (index >= myTokens.size()){ myTokens.resize(index + 1); }
+	myTokens[index]++;
+	myTokenCount++;
+}
+
+namespace {
+
+class NodeCounter : public ASTWalker<NodeCounter>{
+public:
+	explicit NodeCounter(std::vector<size_t>& counts) : myCounts(counts){
+		myCounts.resize(static_cast<size_t>(NodeKind::TIMES) + 1);
+	}
+	bool enter(ASTNode * node){
+		myCounts[static_cast<size_t>(node->kind())]++;
+		myTotal++;
+		return true;
+	}
+	size_t total() const { return myTotal; }
+private:
+	std::vector<size_t>& myCounts;
+	size_t myTotal = 0;
+};
+
+/* Every nonzero count in counts, largest first, one to a line */
+template <typename Name>
+void listCounts(std::ostream& out, const std::vector<size_t>& counts,
+  Name name){
+	std::vector<size_t> order;
+	for (size_t k = 0; k < counts.size(); k++){
+		if (counts[k] != 0){ order.push_back(k); }
+	}
+	std::stable_sort(order.begin(), order.end(),
+	  [&counts](size_t a, size_t b){ return counts[a] > counts[b]; });
+	for (size_t k : order){
+		out << "    " << std::left << std::setw(20) << name(k)
+		  << std::right << std::setw(10) << counts[k] << "\n";
+	}
+}
+
+/* s as the contents of a JSON string */
+std::string jsonEscape(const std::string& s){
+	static const char * const hex = "0123456789abcdef";
+	std::string result;
+	for (char c : s){
+		unsigned char u = static_cast<unsigned char>(c);
+		if (c == '"' || c == '\\'){
+			result += '\\';
+			result += c;
+		} else if (u < 0x20){
+			result += "\\u00";
+			result += hex[u >> 4];
+			result += hex[u & 0xf];
+		} else {
+			result += c;
+		}
+	}
+	return result;
+}
+
+}
+
+void Stats::countNodes(ProgramNode * root){
+	NodeCounter counter(myNodes);
+	counter.walk(root);
+	myNodeCount += counter.total();
+}
+
+void Stats::report(std::ostream& out) const{
+	out << "Stats for " << myInput << ":\n";
+	out << "  " << std::left << std::setw(12) << "phase" << std::right
+	  << std::setw(12) << "wall ms" << std::setw(12) << "cpu ms" << "\n";
+	out << std::fixed << std::setprecision(3);
+	for (const Record& phase : myPhases){
+		out << "  " << std::left << std::setw(12) << phase.name
+		  << std::right << std::setw(12) << phase.wall * 1e3
+		  << std::setw(12) << phase.cpu * 1e3 << "\n";
+	}
+	out.unsetf(std::ios::floatfield);
+	out << "  bytes read: " << myRead << ", written: " << myWritten << "\n";
+	out << "  positions: " << myTokenCount + myNodeCount << " ("
+	  << myTokenCount << " in tokens, " << myNodeCount << " in nodes)\n";
+	out << "  tokens: " << myTokenCount << "\n";
+	listCounts(out, myTokens, [](size_t k){
+		return tokenKindName(static_cast<int>(k));
+	});
+	out << "  nodes: " << myNodeCount << "\n";
+	listCounts(out, myNodes, [](size_t k){
+		return nodeKindName(static_cast<NodeKind>(k));
+	});
+}
+
+/* bytes in KB, to one decimal place */
+static std::string kilobytes(size_t bytes){
+	size_t tenths = (bytes * 10 + 512) / 1024;
+	return std::to_string(tenths / 10) + "." + std::to_string(tenths % 10);
+}
+
+void Stats::memoryReport(std::ostream& out) const{
+	out << "Memory for " << myInput << " (KB):\n";
+	out << "  " << std::left << std::setw(12) << "after" << std::right
+	  << std::setw(12) << "heap live" << std::setw(12) << "peak RSS"
+	  << std::setw(12) << "arena used" << std::setw(12) << "reserved"
+	  << "\n";
+	for (const Record& phase : myPhases){
+		out << "  " << std::left << std::setw(12) << phase.name
+		  << std::right << std::setw(12) << kilobytes(phase.heap)
+		  << std::setw(12) << kilobytes(phase.peakRSS)
+		  << std::setw(12) << kilobytes(phase.arenaBytes)
+		  << std::setw(12) << kilobytes(phase.arenaReserved) << "\n";
+	}
+	out << "  arena peak: " << kilobytes(myArenaProfile.peak())
+	  << "; heap and RSS are the whole process's\n";
+
+	struct Line{
+		const char * name;
+		ArenaProfile::Tally tally;
+	};
+	std::vector<Line> lines;
+	for (const auto& entry : myArenaProfile.tallies()){
+		lines.push_back(Line{entry.first, entry.second});
+	}
+	std::stable_sort(lines.begin(), lines.end(),
+	  [](const Line& a, const Line& b){
+		return a.tally.bytes > b.tally.bytes;
+	});
+	if (myTokenBytes != 0){
+		ArenaProfile::Tally tokens;
+		tokens.count = myTokenCount;
+		tokens.bytes = myTokenBytes;
+		lines.push_back(Line{"Token (buffer)", tokens});
+	}
+	Interner& interner = Interner::global();
+	ArenaProfile::Tally strings;
+	strings.count = interner.size();
+	strings.bytes = interner.bytes();
+	lines.push_back(Line{"strings (process)", strings});
+
+	out << "  " << std::left << std::setw(20) << "allocated" << std::right
+	  << std::setw(10) << "count" << std::setw(12) << "KB"
+	  << std::setw(10) << "each" << "\n";
+	for (const Line& line : lines){
+		size_t count = line.tally.count;
+		out << "    " << std::left << std::setw(18) << line.name
+		  << std::right << std::setw(10) << count
+		  << std::setw(12) << kilobytes(line.tally.bytes)
+		  << std::setw(10) << (count == 0 ? 0 : line.tally.bytes / count)
+		  << "\n";
+	}
+}
+
+void Stats::writeTrace(std::ostream& out,
+  const std::vector<const Stats *>& inputs){
+	const char * sep = "";
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	out << std::fixed << std::setprecision(3);
+	for (const Stats * stats : inputs){
+		if (stats->myPhases.empty()){ continue; }
+		std::string input = jsonEscape(stats->myInput);
+		double first = stats->myPhases.front().start;
+		double last = first;
+		for (const Record& phase : stats->myPhases){
+			out << sep << "\n{\"name\":\"" << phase.name
+			  << "\",\"cat\":\"phase\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+			  << phase.thread << ",\"ts\":" << phase.start * 1e6
+			  << ",\"dur\":" << phase.wall * 1e6
+			  << ",\"args\":{\"input\":\"" << input
+			  << "\",\"cpu_ms\":" << phase.cpu * 1e3 << "}}";
+			sep = ",";
+			if (stats->myMemory){
+				out << sep << "\n{\"name\":\"memory\",\"ph\":\"C\",\"pid\":1"
+				  << ",\"ts\":" << (phase.start + phase.wall) * 1e6
+				  << ",\"args\":{\"heap\":" << phase.heap
+				  << ",\"arena\":" << phase.arenaBytes << "}}";
+			}
+			first = std::min(first, phase.start);
+			last = std::max(last, phase.start + phase.wall);
+		}
+		const Record& head = stats->myPhases.front();
+		out << sep << "\n{\"name\":\"" << input
+		  << "\",\"cat\":\"input\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+		  << head.thread << ",\"ts\":" << first * 1e6
+		  << ",\"dur\":" << (last - first) * 1e6
+		  << ",\"args\":{\"bytesRead\":" << stats->myRead
+		  << ",\"bytesWritten\":" << stats->myWritten
+		  << ",\"tokens\":" << stats->myTokenCount
+		  << ",\"nodes\":" << stats->myNodeCount;
+		for (size_t k = 0; k < stats->myTokens.size(); k++){
+			if (stats->myTokens[k] == 0){ continue; }
+			out << ",\"token "
+			  << jsonEscape(tokenKindName(static_cast<int>(k)))
+			  << "\":" << stats->myTokens[k];
+		}
+		for (size_t k = 0; k < stats->myNodes.size(); k++){
+			if (stats->myNodes[k] == 0){ continue; }
+			out << ",\"" << nodeKindName(static_cast<NodeKind>(k))
+			  << "\":" << stats->myNodes[k];
+		}
+		out << "}}";
+	}
+	out.unsetf(std::ios::floatfield);
+	out << "\n]}\n";
+}
+
+}
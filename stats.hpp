@@ -0,0 +1,108 @@
+#ifndef DREWNO_MARS_STATS_H
+#define DREWNO_MARS_STATS_H
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "arena.hpp"
+#include "ast.hpp"
+#include "tokenbuffer.hpp"
+
+namespace drewno_mars{
+
+/**
+* \class Stats
+* What --stats and --trace report about one input: the wall and CPU
+* time of each phase, the tokens by kind, the AST nodes by class,
+* the positions made and the bytes read and written. A compilation
+* is handed a null Stats pointer when neither was asked for, and
+* every hook then costs one test of that pointer; the counts are
+* taken from the finished token buffer and tree, not as they grow.
+* A streaming compilation has no buffer, so its tokens are counted
+* one at a time as the parser takes them.
+*
+* With memory tracking on (--mem-report) each phase also notes the
+* heap in use and the peak RSS as it ends, and the compilation's
+* arena tallies what it hands out by category into arenaProfile().
+**/
+class Stats{
+public:
+	explicit Stats(const std::string& input) : myInput(input){ }
+
+	void setMemory(bool memory){ myMemory = memory; }
+	/** Where the compilation's arena should tally its allocations,
+	    or null if memory isn't being tracked **/
+	ArenaProfile * arenaProfile(){
+		return myMemory ? &myArenaProfile : nullptr;
+	}
+
+	/**
+	* \class Phase
+	* Times a phase from its construction to its destruction, if
+	* it has somewhere to record it.
+	**/
+	class Phase{
+	public:
+		Phase(Stats * stats, const char * name) : myStats(stats){
+			if (myStats != nullptr){ begin(name); }
+		}
+		~Phase(){
+			if (myStats != nullptr){ end(); }
+		}
+		Phase(const Phase&) = delete;
+		Phase& operator=(const Phase&) = delete;
+	private:
+		void begin(const char * name);
+		void end();
+
+		Stats * myStats;
+		size_t myIndex = 0;
+	};
+
+	void countTokens(const TokenBuffer& tokens);
+	void countToken(int kind);
+	void countNodes(ProgramNode * root);
+	void addRead(size_t bytes){ myRead += bytes; }
+	void addWritten(size_t bytes){ myWritten += bytes; }
+
+	/** The --stats summary, for people **/
+	void report(std::ostream& out) const;
+	/** The --mem-report summary: memory at the end of each phase,
+	    then what was allocated by category **/
+	void memoryReport(std::ostream& out) const;
+	/** Write a Chrome trace-event file of every phase of every
+	    input, each input's counts going on an event of its own
+	    spanning its phases **/
+	static void writeTrace(std::ostream& out,
+	  const std::vector<const Stats *>& inputs);
+private:
+	struct Record{
+		const char * name;
+		unsigned thread;
+		double start;    // wall seconds since the process started
+		double wall;
+		double cpu;      // CPU seconds of the thread that ran it
+		// With memory tracking, as the phase ended
+		size_t heap;
+		size_t peakRSS;
+		size_t arenaBytes;
+		size_t arenaReserved;
+	};
+
+	std::string myInput;
+	std::vector<Record> myPhases;
+	std::vector<size_t> myTokens;    // by kind
+	std::vector<size_t> myNodes;     // by NodeKind
+	size_t myTokenCount = 0;
+	size_t myNodeCount = 0;
+	size_t myRead = 0;
+	size_t myWritten = 0;
+	bool myMemory = false;
+	ArenaProfile myArenaProfile;
+	size_t myTokenBytes = 0;
+};
+
+}
+
+#endif
@@ -0,0 +1,102 @@
+#include "streaming.hpp"
+#include "fastscanner.hpp"
+#include "astbuilder.hpp"
+
+namespace drewno_mars{
+
+using TokenKind = drewno_mars::Parser::token;
+
+static Position shifted(const Position& pos, size_t lineShift){
+	return Position(pos.lineBegin() + lineShift, pos.colBegin(),
+	  pos.lineEnd() + lineShift, pos.colEnd());
+}
+
+StreamParser::StreamParser(DiagnosticEngine& diags, DeclHandler handler,
+  size_t depthLimit)
+: myDiags(diags), myHandler(handler), myDepthLimit(depthLimit){ }
+
+void StreamParser::feed(const char * data, size_t len){
+	/* Everything up to the last newline can be scanned now */
+	size_t whole = len;
+	while (whole > 0 && data[whole - 1] != '\n'){ whole--; }
+	if (whole == 0){
+		myPartial.append(data, len);
+		return;
+	}
+	if (myPartial.empty()){
+		scan(data, data + whole, false);
+	} else {
+		myPartial.append(data, whole);
+		scan(myPartial.data(), myPartial.data() + myPartial.size(), false);
+		myPartial.clear();
+	}
+	myPartial.append(data + whole, len - whole);
+}
+
+void StreamParser::finish(){
+	scan(myPartial.data(), myPartial.data() + myPartial.size(), true);
+	myPartial.clear();
+}
+
+void StreamParser::scan(const char * begin, const char * end, bool atEnd){
+	DiagnosticEngine lexDiags;
+	myScanned.clear();
+	FastScanner(begin, end, &lexDiags).fill(myScanned);
+	for (const Diagnostic& diag : lexDiags.diagnostics()){
+		myDiags.report(diag.severity, diag.id,
+		  shifted(diag.span, myLines), lexDiags.arg(diag));
+	}
+
+	size_t count = myScanned.size() - 1; // Not END
+	for (size_t i = 0; i < count; i++){
+		int kind = myScanned.kind(i);
+		Position span = shifted(myScanned.span(i), myLines);
+		myDecl.push(Token(span, kind, myScanned.payload(i)));
+
+		bool ends = false;
+		if (kind == TokenKind::LCURLY){
+			myDepth++;
+		} else if (kind == TokenKind::RCURLY && myDepth > 0){
+			myDepth--;
+			ends = myDepth == 0 && !myClass;
+		} else if (myDepth == 0){
+			if (kind == TokenKind::CLASS){ myClass = true; }
+			ends = kind == TokenKind::SEMICOL;
+		}
+		if (ends){
+			parseDeclaration(Position(span.lineEnd(), span.colEnd(),
+			  span.lineEnd(), span.colEnd()));
+		}
+	}
+
+	Position endSpan = shifted(myScanned.span(count), myLines);
+	/* The scanner's END sits at the start of the line after */
+	myLines = endSpan.lineBegin() - 1;
+	if (atEnd && myDecl.size() != 0){
+		parseDeclaration(endSpan);
+	}
+}
+
+void StreamParser::parseDeclaration(const Position& endSpan){
+	myDecl.push(Token(endSpan, TokenKind::END));
+	TokenBufferReader reader(myDecl);
+	reader.setDepthLimit(myDepthLimit);
+	PointerBuilder builder(myArena);
+	Parser parser(reader, builder, myDiags);
+	size_t errors = myDiags.count(Severity::ERROR);
+	// The parser recovers from syntax errors, so it can finish anyway
+	if (parser.parse() == 0 && myDiags.count(Severity::ERROR) == errors){
+		for (DeclNode * decl : *builder.root()->globals()){
+			myHandler(decl);
+		}
+	} else {
+		myParsed = false;
+	}
+
+	myArena.reset();
+	myDecl.clear();
+	myDepth = 0;
+	myClass = false;
+}
+
+}
@@ -0,0 +1,84 @@
+#ifndef DREWNO_MARS_STREAMING_H
+#define DREWNO_MARS_STREAMING_H
+
+#include <functional>
+#include <string>
+#include "arena.hpp"
+#include "ast.hpp"
+#include "diagnostics.hpp"
+#include "tokenbuffer.hpp"
+
+namespace drewno_mars{
+
+/**
+* \class StreamParser
+* Parses a program that arrives a piece at a time, e.g. from a pipe
+* fed by a generator, without ever holding the whole of it. Bytes
+* are handed over with feed() as they come, in pieces of any size,
+* and finish() is called at the end of the input.
+*
+* No token spans a line, so each feed() scans the lines it has
+* completed and holds back only the partial last one. Tokens are
+* gathered until they close a top-level declaration (a top-level
+* ';', or the '}' of a function); the declaration is then parsed on
+* its own and handed to the callback right away. The parser recovers
+* from syntax errors at declarations anyway, so each declaration's
+* first error is reported as for the whole text; recovery just can't
+* run on into the next declaration.
+*
+* Memory is bounded by the longest line and declaration: each one's
+* tree lives in an arena that is reset once the callback returns.
+**/
+class StreamParser{
+public:
+	/** Called with each declaration that parsed without a syntax
+	    error. The tree is only valid until the call returns. **/
+	using DeclHandler = std::function<void(DeclNode *)>;
+
+	/** Declarations are parsed with the given limit on the parser's
+	    depth, as Compilation::setDepthLimit **/
+	StreamParser(DiagnosticEngine& diags, DeclHandler handler,
+	  size_t depthLimit = DEFAULT_DEPTH_LIMIT);
+	StreamParser(const StreamParser&) = delete;
+	StreamParser& operator=(const StreamParser&) = delete;
+
+	/** Take the next len bytes of the input **/
+	void feed(const char * data, size_t len);
+	/** The input has ended: parse whatever is left of it **/
+	void finish();
+
+	/** Tally the declarations' arena into profile, as
+	    Arena::setProfile **/
+	void setProfile(ArenaProfile * profile){ myArena.setProfile(profile); }
+
+	/** True if no declaration so far had a syntax error **/
+	bool parsed() const { return myParsed; }
+private:
+	/* Scan [begin, end), the next whole lines of the input (or, at
+	   the end, whatever is left), and parse every declaration they
+	   complete */
+	void scan(const char * begin, const char * end, bool atEnd);
+	/* Parse the gathered tokens, followed by an END at endSpan */
+	void parseDeclaration(const Position& endSpan);
+
+	DiagnosticEngine& myDiags;
+	DeclHandler myHandler;
+	size_t myDepthLimit;
+	/* The input since the last newline */
+	std::string myPartial;
+	/* Lines scanned so far, which the scanner doesn't know of */
+	size_t myLines = 0;
+	TokenBuffer myScanned;
+	/* The declaration being gathered, with the braces open in it
+	   and whether it is a class (whose '}' is followed by ';') */
+	TokenBuffer myDecl;
+	size_t myDepth = 0;
+	bool myClass = false;
+	/* Declarations are small; don't reserve a big block */
+	Arena myArena{4 * 1024};
+	bool myParsed = true;
+};
+
+}
+
+#endif
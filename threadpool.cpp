@@ -0,0 +1,79 @@
+#include "threadpool.hpp"
+
+namespace drewno_mars{
+
+ThreadPool::ThreadPool(size_t threadCount) : myNextQueue(0){
+	if (threadCount == 0){ threadCount = 1; }
+	for (size_t i = 0; i < threadCount; i++){
+		myWorkers.emplace_back(new Worker());
+	}
+	for (size_t i = 0; i < threadCount; i++){
+		myThreads.emplace_back(&ThreadPool::work, this, i);
+	}
+}
+
+ThreadPool::~ThreadPool(){
+	wait();
+	{
+		std::lock_guard<std::mutex> guard(myLock);
+		myStop = true;
+	}
+	myWake.notify_all();
+	for (auto& thread : myThreads){ thread.join(); }
+}
+
+void ThreadPool::submit(Task task){
+	size_t target = myNextQueue++ % myWorkers.size();
+	{
+		std::lock_guard<std::mutex> guard(myWorkers[target]->lock);
+		myWorkers[target]->tasks.push_back(std::move(task));
+	}
+	{
+		std::lock_guard<std::mutex> guard(myLock);
+		myQueued++;
+		myPending++;
+	}
+	myWake.notify_one();
+}
+
+void ThreadPool::wait(){
+	std::unique_lock<std::mutex> guard(myLock);
+	myIdle.wait(guard, [this]{ return myPending == 0; });
+}
+
+bool ThreadPool::take(size_t self, Task& task){
+	size_t count = myWorkers.size();
+	for (size_t k = 0; k < count; k++){
+		Worker& victim = *myWorkers[(self + k) % count];
+		std::lock_guard<std::mutex> guard(victim.lock);
+		if (victim.tasks.empty()){ continue; }
+		task = std::move(victim.tasks.front());
+		victim.tasks.pop_front();
+		return true;
+	}
+	return false;
+}
+
+void ThreadPool::work(size_t self){
+	while (true){
+		{
+			std::unique_lock<std::mutex> guard(myLock);
+			myWake.wait(guard, [this]{ 
+				return myStop || myQueued > 0; 
+			});
+			if (myQueued == 0){ return; } // stopping
+			myQueued--;
+		}
+		/* A task is reserved for us, so one of the deques
+		   holds it (or will, once its submit finishes) */
+		Task task;
+		while (!take(self, task)){ std::this_thread::yield(); }
+		task();
+
+		std::lock_guard<std::mutex> guard(myLock);
+		myPending--;
+		if (myPending == 0){ myIdle.notify_all(); }
+	}
+}
+
+}
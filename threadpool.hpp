@@ -0,0 +1,62 @@
+#ifndef DREWNO_MARS_THREADPOOL_H
+#define DREWNO_MARS_THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace drewno_mars{
+
+/**
+* \class ThreadPool
+* A fixed set of worker threads with one task deque each. A worker
+* runs tasks from the front of its own deque, in the order they
+* were submitted, and when that runs dry steals from the front of
+* the others', so a few slow inputs don't leave the rest of the
+* pool idle. Tasks thus start roughly in submission order, which
+* lets a caller emit results in order without holding most of them.
+**/
+class ThreadPool{
+public:
+	typedef std::function<void()> Task;
+
+	ThreadPool(size_t threadCount);
+	/** Finishes all submitted tasks, then stops the workers **/
+	~ThreadPool();
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	void submit(Task task);
+	/** Block until every submitted task has run **/
+	void wait();
+
+	size_t size() const { return myWorkers.size(); }
+private:
+	struct Worker{
+		std::mutex lock;
+		std::deque<Task> tasks;
+	};
+
+	void work(size_t self);
+	bool take(size_t self, Task& task);
+
+	std::vector<std::unique_ptr<Worker>> myWorkers;
+	std::vector<std::thread> myThreads;
+	std::atomic<size_t> myNextQueue;
+
+	std::mutex myLock;
+	std::condition_variable myWake;
+	std::condition_variable myIdle;
+	size_t myQueued = 0;   // submitted, not yet taken
+	size_t myPending = 0;  // submitted, not yet finished
+	bool myStop = false;
+};
+
+}
+
+#endif
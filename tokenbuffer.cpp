@@ -0,0 +1,70 @@
+#include <string>
+#include "tokenbuffer.hpp"
+
+namespace drewno_mars{
+
+using TokenKind = drewno_mars::Parser::token;
+
+void TokenBuffer::write(Writer& out, size_t first, size_t last,
+  size_t lineShift) const{
+	// Same text as Token::toString, one token per line, but 
+	// formatted straight into the writer's buffer
+	const Interner& strings = Interner::global();
+	for (size_t i = first; i < last; i++){
+		int tokKind = myKinds[i];
+		out << tokenKindName(tokKind);
+		if (tokKind == TokenKind::ID || tokKind == TokenKind::STRINGLITERAL){
+			out << ':';
+			out.write(strings.chars(myPayloads[i]), 
+			  strings.length(myPayloads[i]));
+		} else if (tokKind == TokenKind::INTLITERAL){
+			out << ':' << static_cast<int>(myPayloads[i]);
+		}
+		out << " [" << mySpans[i].lineBegin() + lineShift << ',' 
+		  << mySpans[i].colBegin() << "]\n";
+	}
+}
+
+void TokenBuffer::write(std::ostream& out) const{
+	Writer writer(out);
+	write(writer);
+	writer.flush();
+}
+
+int Lexer::nextToken(Parser::semantic_type * lval){
+	int tokenKind = scanToken(lval);
+	if (tokenKind == TokenKind::END){
+		myAtEOF = true;
+		myLastSpan = Position(lineNum, colNum, lineNum, colNum);
+		if (myRecord != nullptr){
+			myRecord->push(Token(myLastSpan, tokenKind));
+		}
+	} else {
+		myLastSpan = *lval->transToken.pos();
+		if (myRecord != nullptr){
+			myRecord->push(lval->transToken);
+		}
+	}
+	return tokenKind;
+}
+
+int TokenSource::nextTokenAt(size_t depth, Parser::semantic_type * lval,
+  DiagnosticEngine& diags){
+	if (!myCutOff && myDepthLimit != 0 && depth > myDepthLimit){
+		myCutOff = true;
+		diags.report(Severity::ERROR, DiagID::TOO_DEEP, myLastSpan,
+		  std::to_string(myDepthLimit));
+	}
+	if (myCutOff){ return TokenKind::END; }
+	return nextToken(lval);
+}
+
+void Lexer::fill(TokenBuffer& tokens){
+	TokenBuffer * saved = myRecord;
+	myRecord = &tokens;
+	Parser::semantic_type lex;
+	while (!myAtEOF){ nextToken(&lex); }
+	myRecord = saved;
+}
+
+}
@@ -0,0 +1,158 @@
+#ifndef DREWNO_MARS_TOKENBUFFER_H
+#define DREWNO_MARS_TOKENBUFFER_H
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+#include "frontend.hh" // Token kind definitions
+#include "tokens.hpp"
+#include "writer.hpp"
+
+namespace drewno_mars{
+
+/**
+* \class TokenBuffer
+* A whole token stream, EOF included, stored as a struct of arrays:
+* kinds, spans and payloads each live in their own contiguous 
+* array, so a pass that only looks at kinds (like the parser's 
+* lookahead) touches only that array.
+**/
+class TokenBuffer{
+public:
+	void push(const Token& tok){
+		myKinds.push_back(static_cast<uint16_t>(tok.kind()));
+		mySpans.push_back(*tok.pos());
+		myPayloads.push_back(tok.payload());
+	}
+	void reserve(size_t count){
+		myKinds.reserve(count);
+		mySpans.reserve(count);
+		myPayloads.reserve(count);
+	}
+	void clear(){
+		myKinds.clear();
+		mySpans.clear();
+		myPayloads.clear();
+	}
+
+	size_t size() const { return myKinds.size(); }
+	/** Bytes held for the arrays, including room not yet used **/
+	size_t bytes() const {
+		return myKinds.capacity() * sizeof(uint16_t)
+		  + mySpans.capacity() * sizeof(Position)
+		  + myPayloads.capacity() * sizeof(uint32_t);
+	}
+	int kind(size_t i) const { return myKinds[i]; }
+	const Position& span(size_t i) const { return mySpans[i]; }
+	uint32_t payload(size_t i) const { return myPayloads[i]; }
+	Token at(size_t i) const {
+		return Token(mySpans[i], myKinds[i], myPayloads[i]);
+	}
+
+	/** Dump the stream in the -t format **/
+	void write(Writer& out) const{ write(out, 0, size(), 0); }
+	/** Dump tokens [first, last), adding lineShift to each line **/
+	void write(Writer& out, size_t first, size_t last, 
+	  size_t lineShift) const;
+	void write(std::ostream& out) const;
+private:
+	std::vector<uint16_t> myKinds;
+	std::vector<Position> mySpans;
+	std::vector<uint32_t> myPayloads;
+};
+
+/* How many symbols deep the parser's stack may get by default. Each
+   nested block costs about six, a parenthesis or a '!' one or two. */
+static const size_t DEFAULT_DEPTH_LIMIT = 10000;
+
+/**
+* \class TokenSource
+* Whatever the parser pulls its tokens from: either the scanner 
+* itself or a previously filled TokenBuffer.
+*
+* The parser asks through nextTokenAt(), which also bounds how deep
+* its stack may grow. An input nested past the limit gets one
+* diagnostic, and the parser is then handed END until it gives up,
+* instead of growing the stack (and the tree) without end.
+**/
+class TokenSource{
+public:
+	virtual ~TokenSource(){ }
+	/** Store the next token in lval and return its kind. Once
+	    the end is reached every call returns END. **/
+	virtual int nextToken(Parser::semantic_type * lval) = 0;
+	/** nextToken() for a parser whose stack is depth symbols deep,
+	    or END for good once that passes the depth limit, which is
+	    reported to diags the first time **/
+	int nextTokenAt(size_t depth, Parser::semantic_type * lval,
+	  DiagnosticEngine& diags);
+	/** Span of the token nextToken() returned last, which is the
+	    one the parser was looking at when it found an error **/
+	const Position& lastSpan() const { return myLastSpan; }
+
+	/** The deepest the parser's stack may get (0 = no limit) **/
+	void setDepthLimit(size_t limit){ myDepthLimit = limit; }
+	/** True once the input has been cut off at the depth limit **/
+	bool cutOff() const { return myCutOff; }
+protected:
+	Position myLastSpan = Position(0,0,0,0);
+private:
+	size_t myDepthLimit = DEFAULT_DEPTH_LIMIT;
+	bool myCutOff = false;
+};
+
+/**
+* \class Lexer
+* A TokenSource that reads source text: the flex-generated Scanner
+* or the hand-written FastScanner. Subclasses only provide 
+* scanToken(); this class records what they hand out, appends the
+* EOF token and can run them ahead to fill a whole TokenBuffer.
+**/
+class Lexer : public TokenSource{
+public:
+	/** scanToken(), plus recording of each token handed out (and
+	    the final EOF) when recordInto has been given somewhere to
+	    put them **/
+	int nextToken(Parser::semantic_type * lval) override;
+
+	void recordInto(TokenBuffer * tokens){ myRecord = tokens; }
+	bool atEOF() const { return myAtEOF; }
+
+	/** Scan the rest of the input into tokens, through EOF **/
+	void fill(TokenBuffer& tokens);
+protected:
+	/** Scan one token into lval and return its kind, or END **/
+	virtual int scanToken(Parser::semantic_type * lval) = 0;
+
+	/* Where the next token starts */
+	size_t lineNum = 1;
+	size_t colNum = 1;
+private:
+	TokenBuffer * myRecord = nullptr;
+	bool myAtEOF = false;
+};
+
+/**
+* \class TokenBufferReader
+* Feeds the tokens of a TokenBuffer to the parser, in order. The
+* buffer must be complete, i.e. end with its END token.
+**/
+class TokenBufferReader : public TokenSource{
+public:
+	TokenBufferReader(const TokenBuffer& bufferIn)
+	: myBuffer(bufferIn){ }
+	int nextToken(Parser::semantic_type * lval) override{
+		size_t i = myNext;
+		if (i + 1 < myBuffer.size()){ myNext++; }
+		lval->transToken = myBuffer.at(i);
+		myLastSpan = myBuffer.span(i);
+		return myBuffer.kind(i);
+	}
+private:
+	const TokenBuffer& myBuffer;
+	size_t myNext = 0;
+};
+
+}
+
+#endif
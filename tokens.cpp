@@ -1,5 +1,6 @@
 #include "tokens.hpp" // Get the class declarations
 #include "frontend.hh" // Get the TokenKind definitions
+#include <vector>
 
 namespace drewno_mars{
 
@@ -55,60 +56,70 @@ static std::string tokenKindString(int tokKind){
 	}
 }
 
-Token::Token(Position * posIn, int kindIn)
-  : myPos(posIn), myKind(kindIn){
+/* Names of the kinds bison can hand out, indexed by kind. Built
+   once from tokenKindString so the two can never disagree. */
+static const int KIND_TABLE_SIZE = 512;
+
+const std::string& tokenKindName(int kind){
+	static const std::vector<std::string> names = [](){
+		std::vector<std::string> table;
+		table.reserve(KIND_TABLE_SIZE);
+		for (int k = 0; k < KIND_TABLE_SIZE; k++){
+			table.push_back(tokenKindString(k));
+		}
+		return table;
+	}();
+	static const std::string other = "OTHER";
+	if (kind < 0 || kind >= KIND_TABLE_SIZE){ return other; }
+	return names[static_cast<size_t>(kind)];
 }
 
-std::string Token::toString(){
-	return tokenKindString(kind())
-	+ " " + myPos->begin();
+Token::Token(const Position& posIn, int kindIn, uint32_t payloadIn)
+  : myPos(posIn), myKind(kindIn), myPayload(payloadIn){
 }
 
-int Token::kind() const { 
-	return this->myKind; 
-}
-
-const Position * Token::pos() const {
-	return myPos;
-}
-
-IDToken::IDToken(Position * posIn, std::string vIn)
-  : Token(posIn, TokenKind::ID), myValue(vIn){ 
+std::string Token::toString() const{
+	std::string result = tokenKindName(kind());
+	switch(kind()){
+		case TokenKind::ID:
+		case TokenKind::STRINGLITERAL:
+			result += ":" + Interner::global().str(text());
+			break;
+		case TokenKind::INTLITERAL:
+			result += ":" + std::to_string(num());
+			break;
+		default:
+			break;
+	}
+	return result + " " + myPos.begin();
 }
 
-std::string IDToken::toString(){
-	return tokenKindString(kind()) + ":"
-	+ myValue + " " + myPos->begin();
+size_t Token::line() const {
+	return myPos.lineBegin();
 }
 
-const std::string IDToken::value() const { 
-	return this->myValue; 
+size_t Token::col() const {
+	return myPos.colBegin();
 }
 
-StrToken::StrToken(Position * posIn, std::string sIn)
-  : Token(posIn, TokenKind::STRINGLITERAL), myStr(sIn){
+int Token::kind() const { 
+	return this->myKind; 
 }
 
-std::string StrToken::toString(){
-	return tokenKindString(kind()) + ":"
-	+ this->myStr + " " + myPos->begin();
+const Position * Token::pos() const {
+	return &myPos;
 }
 
-const std::string StrToken::str() const {
-	return this->myStr;
+uint32_t Token::payload() const {
+	return this->myPayload;
 }
 
-IntLitToken::IntLitToken(Position * pos, int numIn)
-  : Token(pos, TokenKind::INTLITERAL), myNum(numIn){}
-
-std::string IntLitToken::toString(){
-	return tokenKindString(kind()) + ":"
-	+ std::to_string(this->myNum) + " "
-	+ myPos->begin();
+int Token::num() const {
+	return static_cast<int>(this->myPayload);
 }
 
-int IntLitToken::num() const {
-	return this->myNum;
+StrHandle Token::text() const {
+	return this->myPayload;
 }
 
 } //End namespace drewno_mars
@@ -1,51 +1,37 @@
 #ifndef DREWNO_MARS_TOKEN_H
 #define DREWNO_MARS_TOKEN_H
 
+#include <cstdint>
 #include <string>
 #include "position.hpp"
+#include "interner.hpp"
 
 namespace drewno_mars{
 
+/* The name of a token kind as -t prints it, e.g. "ID" or "EOF" */
+const std::string& tokenKindName(int kind);
+
+/* A token is a small value (kind, span and a payload word) that
+   is copied through the parser's semantic stack rather than 
+   allocated. The payload holds the value of an INTLITERAL, and
+   for an ID or STRINGLITERAL the interned handle of its text.
+   Every other kind leaves it at 0. */
 class Token{
 public:
-	Token(Position * pos, int kindIn);
-	virtual std::string toString();
+	Token() = default;
+	Token(const Position& posIn, int kindIn, uint32_t payloadIn = 0);
+	std::string toString() const;
 	size_t line() const;
 	size_t col() const;
 	int kind() const;
 	const Position * pos() const;
-protected:
-	const Position * myPos;
-private:
-	const int myKind;
-};
-
-class IDToken : public Token{
-public:
-	IDToken(Position * posIn, std::string valIn);
-	const std::string value() const;
-	virtual std::string toString() override;
-private:
-	const std::string myValue;
-	
-};
-
-class StrToken : public Token{
-public:
-	StrToken(Position * posIn, std::string valIn);
-	virtual std::string toString() override;
-	const std::string str() const;
-private:
-	const std::string myStr;
-};
-
-class IntLitToken : public Token{
-public:
-	IntLitToken(Position * posIn, int numIn);
-	virtual std::string toString() override;
+	uint32_t payload() const;
 	int num() const;
+	StrHandle text() const;
 private:
-	const int myNum;
+	Position myPos;
+	int myKind;
+	uint32_t myPayload;
 };
 
 }
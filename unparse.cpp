@@ -1,379 +1,381 @@
+#include <algorithm>
+#include <cstddef>
+#include <vector>
 #include "ast.hpp"
+#include "visitor.hpp"
 
 namespace drewno_mars{
 
 /*
-doIndent is declared static, which means that it can 
+writeStr is declared static, which means that it can
 only be called in this file (its symbol is not exported).
 */
-static void doIndent(std::ostream& out, int indent){
-	for (int k = 0 ; k < indent; k++){ out << "\t"; }
-}
-
-/*
-In this code, the intention is that functions are grouped 
-into files by purpose, rather than by class.
-If you're used to having all of the functions of a class 
-defined in the same file, this style may be a bit disorienting,
-though it is legal. Thus, we can have
-ProgramNode::unparse, which is the unparse method of ProgramNodes
-defined in the same file as DeclNode::unparse, the unparse method
-of DeclNodes.
-*/
-
-
-void ProgramNode::unparse(std::ostream& out, int indent){
-	/* Oh, hey it's a for-each loop in C++!
-	   The loop iterates over each element in a collection
-	   without that gross i++ nonsense. 
-	 */
-	for (auto global : *myGlobals){
-		/* The auto keyword tells the compiler
-		   to (try to) figure out what the
-		   type of a variable should be from 
-		   context. here, since we're iterating
-		   over a list of DeclNode *s, it's 
-		   pretty clear that global is of 
-		   type DeclNode *.
-		*/
-		global->unparse(out, indent);
+static void writeStr(Writer& out, StrHandle h){
+	const Interner& strings = Interner::global();
+	out.write(strings.chars(h), strings.length(h));
+}
+
+/**
+* \class Unparser
+* Writes a tree back out in canonical form. Statements and
+* declarations are indented by the current depth; expressions and
+* types never are. An expression that is the operand of another
+* is wrapped in parentheses unless it is a single name, literal or
+* call.
+*
+* A visit hands what it has to do (children, text, indents) to
+* then(), which does it on the spot while nothing is queued ahead
+* of it. Children are visited on the spot only down to a fixed
+* depth, though; past that they are queued, along with everything
+* after them, and run() gets to them in order. The queue is a stack
+* of the unparser's own, so however deep the tree, the native stack
+* holds at most that fixed depth of visits.
+**/
+class Unparser : public ASTVisitor<Unparser>{
+public:
+	Unparser(Writer& out, int indent) : myOut(out), myIndent(indent){ }
+
+	void run(ASTNode * root){
+		Work start;
+		start.kind = Work::NODE;
+		start.node = root;
+		myWork.push_back(start);
+		while (!myWork.empty()){
+			Work work = myWork.back();
+			myWork.pop_back();
+			myFirst = myWork.size();
+			perform(work);
+			// What it queued is done from the back
+			std::reverse(myWork.begin() + static_cast<std::ptrdiff_t>(myFirst),
+			  myWork.end());
+		}
 	}
-}
-
-void VarDeclNode::unparse(std::ostream& out, int indent){
-	doIndent(out, indent);
-	this->myID->unparse(out, 0);
-	out << " : ";
-	this->myType->unparse(out, 0);
-    if (this->myExp != nullptr){
-        out << " = ";
-        this->myExp->unparse(out, 0);
-    }
-	out << ";\n";
-}
-
-void ExpNode::nestedUnparse(std::ostream &out, int indent) {
-    out << "(";
-    unparse(out, 0);
-    out << ")";
-}
-
-void IDNode::unparse(std::ostream& out, int indent){
-	out << this->name;
-}
 
-void IntTypeNode::unparse(std::ostream& out, int indent){
-	out << "int";
-}
-
-void BoolTypeNode::unparse(std::ostream &out, int indent) {
-    out << "bool";
-}
-
-void VoidTypeNode::unparse(std::ostream &out, int indent) {
-    out << "void";
-}
-
-void IntLitNode::unparse(std::ostream &out, int indent) {
-    out << this->value;
-}
-
-void StrLitNode::unparse(std::ostream &out, int indent) {
-    out << this->str;
-}
-
-void TrueNode::unparse(std::ostream &out, int indent) {
-    out << "true";
-}
-
-void FalseNode::unparse(std::ostream &out, int indent) {
-    out << "false";
-}
-
-void MagicNode::unparse(std::ostream &out, int indent) {
-    out << "24Kmagic";
-}
-
-void MemberFieldExpNode::unparse(std::ostream &out, int indent) {
-    this->loc->unparse(out, 0);
-    out << "--";
-    this->name->unparse(out, 0);
-}
-
-void CallExpNode::unparse(std::ostream &out, int indent) {
-    functionName->unparse(out, 0);
-    out << "(";
-
-    bool firstArg = true;
-    for(auto arg : *args){
-        if (firstArg) {
-            firstArg = false;
-        }
-        else {
-            out << ", ";
-        }
-        arg->unparse(out, 0);
-    }
-    out << ")";
-}
-
-void AndNode::unparse(std::ostream &out, int indent) {
-    this->lhs->nestedUnparse(out, 0);
-    out << " and ";
-    this->rhs->nestedUnparse(out,0);
-}
-
-void DivideNode::unparse(std::ostream &out, int indent) {
-    this->lhs->nestedUnparse(out, 0);
-    out << " / ";
-    this->rhs->nestedUnparse(out,0);
-}
-
-void EqualsNode::unparse(std::ostream &out, int indent) {
-    this->lhs->nestedUnparse(out, 0);
-    out << " == ";
-    this->rhs->nestedUnparse(out,0);
-}
-
-void GreaterEqNode::unparse(std::ostream &out, int indent) {
-    this->lhs->nestedUnparse(out, 0);
-    out << " >= ";
-    this->rhs->nestedUnparse(out,0);
-}
-
-void GreaterNode::unparse(std::ostream &out, int indent) {
-    this->lhs->nestedUnparse(out, 0);
-    out << " > ";
-    this->rhs->nestedUnparse(out,0);
-}
-
-void LessNode::unparse(std::ostream &out, int indent) {
-    this->lhs->nestedUnparse(out, 0);
-    out << " < ";
-    this->rhs->nestedUnparse(out,0);
-}
+	void visitProgram(ProgramNode * node){
+		/* Oh, hey it's a for-each loop in C++!
+		   The loop iterates over each element in a collection
+		   without that gross i++ nonsense.
+		 */
+		for (auto global : *node->globals()){
+			/* The auto keyword tells the compiler
+			   to (try to) figure out what the
+			   type of a variable should be from
+			   context. here, since we're iterating
+			   over a list of DeclNode *s, it's
+			   pretty clear that global is of
+			   type DeclNode *.
+			*/
+			then(global);
+		}
+	}
 
-void LessEqNode::unparse(std::ostream &out, int indent) {
-    this->lhs->nestedUnparse(out, 0);
-    out << " <= ";
-    this->rhs->nestedUnparse(out,0);
-}
+	void visitVarDecl(VarDeclNode * node){
+		myOut.indent(myIndent);
+		then(node->getID());
+		then(" : ");
+		then(node->getType());
+		if (node->getExp() != nullptr){
+			then(" = ");
+			then(node->getExp());
+		}
+		then(";\n");
+	}
 
-void MinusNode::unparse(std::ostream &out, int indent) {
-    this->lhs->nestedUnparse(out, 0);
-    out << " - ";
-    this->rhs->nestedUnparse(out,0);
-}
+	void visitFormalDecl(FormalDeclNode * node){
+		// Formals sit inside the function's header line
+		then(node->getID());
+		then(" : ");
+		then(node->getType());
+	}
 
-void  NotEqualsNode::unparse(std::ostream &out, int indent) {
-    this->lhs->nestedUnparse(out, 0);
-    out << " != ";
-    this->rhs->nestedUnparse(out,0);
-}
+	void visitFnDecl(FnDeclNode * node){
+		myOut.indent(myIndent);
+		then(node->getID());
+		then(" : (");
+		bool firstDecl = true;
+		for (auto decl : *node->getDecls()){
+			if (firstDecl){
+				firstDecl = false;
+			} else {
+				then(", ");
+			}
+			then(decl);
+		}
+		then(") ");
+		then(node->getType());
+		then(" {\n");
+		block(node->getStmts());
+		thenIndent();
+		then("}\n");
+	}
 
-void OrNode::unparse(std::ostream &out, int indent) {
-    this->lhs->nestedUnparse(out, 0);
-    out << " or ";
-    this->rhs->nestedUnparse(out,0);
-}
+	void visitClassDecl(ClassDeclNode * node){
+		myOut.indent(myIndent);
+		then(node->getName());
+		then(" : class {\n");
+		block(node->getDecls());
+		thenIndent();
+		then("};\n");
+	}
 
-void PlusNode::unparse(std::ostream &out, int indent) {
-    this->lhs->nestedUnparse(out, 0);
-    out << " + ";
-    this->rhs->nestedUnparse(out,0);
-}
+	void visitIntType(IntTypeNode *){ myOut << "int"; }
+	void visitBoolType(BoolTypeNode *){ myOut << "bool"; }
+	void visitVoidType(VoidTypeNode *){ myOut << "void"; }
+	void visitClassType(ClassTypeNode * node){ then(node->getID()); }
+	void visitPerfectType(PerfectTypeNode * node){
+		myOut << "perfect ";
+		then(node->getType());
+	}
 
-void TimesNode::unparse(std::ostream &out, int indent) {
-    this->lhs->nestedUnparse(out, 0);
-    out << " * ";
-    this->rhs->nestedUnparse(out,0);
-}
+	void visitAssign(AssignStmtNode * node){
+		myOut.indent(myIndent);
+		then(node->getDest());
+		then(" = ");
+		then(node->getExp());
+		then(";\n");
+	}
 
-void NegNode::unparse(std::ostream &out, int indent) {
-    out << "-";
-    this->exp->nestedUnparse(out, 0);
-}
+	void visitCallStmt(CallStmtNode * node){
+		myOut.indent(myIndent);
+		then(node->getCall());
+		then(";\n");
+	}
 
-void NotNode::unparse(std::ostream &out, int indent) {
-    out << "!";
-    this->exp->nestedUnparse(out, 0);
-}
+	void visitExit(ExitStmtNode *){
+		myOut.indent(myIndent);
+		myOut << "today I don't feel like doing any work;\n";
+	}
 
-void AssignStmtNode::unparse(std::ostream &out, int indent) {
-    doIndent(out, indent);
-    this->dest->unparse(out, 0);
-    out << " = ";
-    this->exp->unparse(out, 0);
-    out << ";\n";
-}
+	void visitGive(GiveStmtNode * node){
+		myOut.indent(myIndent);
+		myOut << "give ";
+		then(node->getExp());
+		then(";\n");
+	}
 
-void CallStmtNode::unparse(std::ostream &out, int indent) {
-    doIndent(out, indent);
-    this->call->unparse(out, 0);
-    out << ";\n";
-}
+	void visitPostDec(PostDecStmtNode * node){
+		myOut.indent(myIndent);
+		then(node->getLoc());
+		then("--;\n");
+	}
 
-void ExitStmtNode::unparse(std::ostream &out, int indent) {
-    doIndent(out, indent);
-    out << "today I don't feel like doing any work;\n";
-}
+	void visitPostInc(PostIncStmtNode * node){
+		myOut.indent(myIndent);
+		then(node->getLoc());
+		then("++;\n");
+	}
 
-void GiveStmtNode::unparse(std::ostream &out, int indent) {
-    doIndent(out, indent);
-    out << "give ";
-    this->exp->unparse(out, 0);
-    out << ";\n";
-}
+	void visitReturn(ReturnStmtNode * node){
+		myOut.indent(myIndent);
+		myOut << "return";
+		if (node->getExp() != nullptr){
+			myOut << " ";
+			then(node->getExp());
+		}
+		then(";\n");
+	}
 
-void PostDecStmtNode::unparse(std::ostream &out, int indent) {
-    doIndent(out, indent);
-    this->loc->unparse(out, 0);
-    out << "--;\n";
-}
+	void visitTake(TakeStmtNode * node){
+		myOut.indent(myIndent);
+		myOut << "take ";
+		then(node->getLoc());
+		then(";\n");
+	}
 
-void PostIncStmtNode::unparse(std::ostream &out, int indent) {
-    doIndent(out, indent);
-    this->loc->unparse(out, 0);
-    out << "++;\n";
-}
+	void visitIfElse(IfElseStmtNode * node){
+		myOut.indent(myIndent);
+		myOut << "if (";
+		then(node->getCondition());
+		then(") {\n");
+		block(node->getTrueBranch());
+		thenIndent();
+		then("} else {\n");
+		block(node->getFalseBranch());
+		thenIndent();
+		then("}\n");
+	}
 
-void ReturnStmtNode::unparse(std::ostream &out, int indent) {
-    doIndent(out, indent);
-    out << "return ";
-    this->exp->unparse(out, 0);
-    out << ";\n";
-}
+	void visitIf(IfStmtNode * node){
+		myOut.indent(myIndent);
+		myOut << "if (";
+		then(node->getCondition());
+		then(") {\n");
+		block(node->getStmts());
+		thenIndent();
+		then("}\n");
+	}
 
-void TakeStmtNode::unparse(std::ostream &out, int indent) {
-    doIndent(out, indent);
-    out << "take ";
-    this->loc->unparse(out, 0);
-    out << ";\n";
-}
+	void visitWhile(WhileStmtNode * node){
+		myOut.indent(myIndent);
+		myOut << "while (";
+		then(node->getExp());
+		then(") {\n");
+		block(node->getStmts());
+		thenIndent();
+		then("}\n");
+	}
 
-void IfElseStmtNode::unparse(std::ostream &out, int indent) {
-    doIndent(out, indent);
-    out << "if (";
-    this->condition->unparse(out, 0);
-    out << ") {\n";
-    for (auto stmt: *trueBranch) {
-        stmt->unparse(out, indent+1);
-    }
-    doIndent(out, indent);
-    out << "} else {\n";
-    for (auto stmt: *falseBranch) {
-        stmt->unparse(out, indent+1);
-    }
-    doIndent(out, indent);
-    out << "}\n";
-}
+	void visitID(IDNode * node){ writeStr(myOut, node->getName()); }
+	void visitIntLit(IntLitNode * node){ myOut << node->getValue(); }
+	void visitStrLit(StrLitNode * node){ writeStr(myOut, node->getStr()); }
+	void visitTrue(TrueNode *){ myOut << "true"; }
+	void visitFalse(FalseNode *){ myOut << "false"; }
+	void visitMagic(MagicNode *){ myOut << "24Kmagic"; }
+
+	void visitMemberField(MemberFieldExpNode * node){
+		then(node->getLoc());
+		then("--");
+		then(node->getName());
+	}
 
-void IfStmtNode::unparse(std::ostream &out, int indent) {
-    doIndent(out, indent);
-    out << "if (";
-    this->condition->unparse(out, 0);
-    out << ") {\n";
-    for (auto stmt: *stmts) {
-        stmt->unparse(out, indent+1);
-    }
-    doIndent(out, indent);
-    out << "}\n";
-}
+	void visitCallExp(CallExpNode * node){
+		then(node->getFunctionName());
+		then("(");
+		bool firstArg = true;
+		for (auto arg : *node->getArgs()){
+			if (firstArg){
+				firstArg = false;
+			} else {
+				then(", ");
+			}
+			then(arg);
+		}
+		then(")");
+	}
 
-void WhileStmtNode::unparse(std::ostream &out, int indent) {
-    doIndent(out, indent);
-    out << "while (";
-    this->exp->unparse(out, 0);
-    out << ") {\n";
-    for (auto stmt: *stmts) {
-        stmt->unparse(out, indent+1);
-    }
-    doIndent(out, indent);
-    out << "}\n";
-}
+	void visitNeg(NegNode * node){
+		myOut << "-";
+		nested(node->getExp());
+	}
 
-void FormalDeclNode::unparse(std::ostream &out, int indent) {
-    doIndent(out, indent);
-    this->myID->unparse(out, 0);
-    out << " : ";
-    this->myType->unparse(out, 0);
-}
+	void visitNot(NotNode * node){
+		myOut << "!";
+		nested(node->getExp());
+	}
 
-void FnDeclNode::unparse(std::ostream &out, int indent) {
-    doIndent(out, indent);
-    this->id->unparse(out, 0);
-    out << " : (";
-
-    bool firstDecl = true;
-    for(auto decl : *decls){
-        if (firstDecl) {
-            firstDecl = false;
-        }
-        else {
-            out << ", ";
-        }
-        decl->unparse(out, 0);
-    }
-    out << ") ";
-
-    this->type->unparse(out, 0);
-    out << " {\n";
-
-    for (auto stmt: *stmts) {
-        stmt->unparse(out, indent+1);
-    }
-    doIndent(out, indent);
-    out << "}\n";
-}
+	void visitAnd(AndNode * node){ binary(node, " and "); }
+	void visitDivide(DivideNode * node){ binary(node, " / "); }
+	void visitEquals(EqualsNode * node){ binary(node, " == "); }
+	void visitGreaterEq(GreaterEqNode * node){ binary(node, " >= "); }
+	void visitGreater(GreaterNode * node){ binary(node, " > "); }
+	void visitLess(LessNode * node){ binary(node, " < "); }
+	void visitLessEq(LessEqNode * node){ binary(node, " <= "); }
+	void visitMinus(MinusNode * node){ binary(node, " - "); }
+	void visitNotEquals(NotEqualsNode * node){ binary(node, " != "); }
+	void visitOr(OrNode * node){ binary(node, " or "); }
+	void visitPlus(PlusNode * node){ binary(node, " + "); }
+	void visitTimes(TimesNode * node){ binary(node, " * "); }
+private:
+	/* One thing left to do: unparse a node, write some text, write
+	   the current indent, or move the indent a level */
+	struct Work{
+		enum Kind : uint8_t { NODE, TEXT, INDENT, DEEPER, SHALLOWER } kind;
+		union {
+			ASTNode * node;
+			const char * text;
+		};
+	};
+
+	void perform(const Work& work){
+		switch (work.kind){
+		case Work::NODE: visit(work.node); break;
+		case Work::TEXT: myOut << work.text; break;
+		case Work::INDENT: myOut.indent(myIndent); break;
+		case Work::DEEPER: myIndent++; break;
+		case Work::SHALLOWER: myIndent--; break;
+		}
+	}
 
-void PerfectTypeNode::unparse(std::ostream &out, int indent) {
-    out << "perfect ";
-    this->type->unparse(out, indent);
-}
+	/* Do work now if nothing is queued ahead of it, and it isn't
+	   a visit too deep for the native stack; else queue it */
+	void then(const Work& work){
+		if (myWork.size() != myFirst){
+			myWork.push_back(work);
+		} else if (work.kind != Work::NODE){
+			perform(work);
+		} else if (myDepth < MAX_DEPTH){
+			myDepth++;
+			visit(work.node);
+			myDepth--;
+		} else {
+			myWork.push_back(work);
+		}
+	}
 
-void ClassDeclNode::unparse(std::ostream &out, int indent) {
-    doIndent(out, indent);
-    this->name->unparse(out, indent);
-    out << " : class {\n";
+	void then(ASTNode * node){
+		Work work;
+		work.kind = Work::NODE;
+		work.node = node;
+		then(work);
+	}
 
-    for(auto decl : *decls) {
-        decl->unparse(out, indent+1);
-    }
+	void then(const char * text){
+		Work work;
+		work.kind = Work::TEXT;
+		work.text = text;
+		then(work);
+	}
 
-    doIndent(out, indent);
-    out << "};\n";
-}
+	void then(Work::Kind kind){
+		Work work;
+		work.kind = kind;
+		work.node = nullptr;
+		then(work);
+	}
 
-void ClassTypeNode::unparse(std::ostream &out, int indent) {
-    this->id->unparse(out, indent);
-}
+	void thenIndent(){ then(Work::INDENT); }
 
-void IDNode::nestedUnparse(std::ostream &out, int indent) {
-    unparse(out,0);
-}
+	/* The statements of a body, one level deeper */
+	template <typename T>
+	void block(const NodeList<T *> * stmts){
+		then(Work::DEEPER);
+		for (auto stmt : *stmts){ then(stmt); }
+		then(Work::SHALLOWER);
+	}
 
-void CallExpNode::nestedUnparse(std::ostream &out, int indent) {
-    unparse(out,0);
-}
+	void binary(BinaryExpNode * node, const char * op){
+		nested(node->getLhs());
+		then(op);
+		nested(node->getRhs());
+	}
 
-void FalseNode::nestedUnparse(std::ostream &out, int indent) {
-    unparse(out,0);
-}
+	/* An operand, in parentheses unless it can't be split */
+	void nested(ExpNode * exp){
+		switch (exp->kind()){
+		case NodeKind::ID:
+		case NodeKind::CALL_EXP:
+		case NodeKind::FALSE_LIT:
+		case NodeKind::TRUE_LIT:
+		case NodeKind::MAGIC:
+		case NodeKind::STR_LIT:
+		case NodeKind::INT_LIT:
+			then(exp);
+			break;
+		default:
+			then("(");
+			then(exp);
+			then(")");
+		}
+	}
 
-void TrueNode::nestedUnparse(std::ostream &out, int indent) {
-    unparse(out,0);
-}
+	Writer& myOut;
+	int myIndent;
+	/* How deep visits may nest on the native stack */
+	static const int MAX_DEPTH = 100;
 
-void MagicNode::nestedUnparse(std::ostream &out, int indent) {
-    unparse(out,0);
-}
+	std::vector<Work> myWork;
+	size_t myFirst = 0;    // where the current step's work is queued
+	int myDepth = 0;       // visits nested on the native stack
+};
 
-void StrLitNode::nestedUnparse(std::ostream &out, int indent) {
-    unparse(out,0);
+void ASTNode::unparse(Writer& out, int indent){
+	Unparser(out, indent).run(this);
 }
 
-void IntLitNode::nestedUnparse(std::ostream &out, int indent) {
-    unparse(out,0);
+void ASTNode::unparse(std::ostream& out, int indent){
+	Writer writer(out);
+	unparse(writer, indent);
+	writer.flush();
 }
 
 } // End namespace drewno_mars
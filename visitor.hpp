@@ -0,0 +1,458 @@
+#ifndef DREWNO_MARS_VISITOR_H
+#define DREWNO_MARS_VISITOR_H
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+#include "ast.hpp"
+
+namespace drewno_mars{
+
+/**
+* \class ASTVisitor
+* Calls the visit method of Derived that matches a node's kind, with
+* the node already cast to its class. Dispatch is one switch on the
+* kind tag and every call is static, so a whole pass can be inlined.
+*
+* Derived defines only the visit methods it needs (hiding, not
+* overriding, the ones here). The rest fall back to the method for
+* the node's category, e.g. visitPlus to visitBinaryExp to visitExp
+* to visitNode, which does nothing and returns Result().
+**/
+template <typename Derived, typename Result = void>
+class ASTVisitor{
+public:
+	Result visit(ASTNode * node){
+		switch (node->kind()){
+		case NodeKind::PROGRAM:
+			return self().visitProgram(static_cast<ProgramNode *>(node));
+		case NodeKind::INT_TYPE:
+			return self().visitIntType(static_cast<IntTypeNode *>(node));
+		case NodeKind::BOOL_TYPE:
+			return self().visitBoolType(static_cast<BoolTypeNode *>(node));
+		case NodeKind::VOID_TYPE:
+			return self().visitVoidType(static_cast<VoidTypeNode *>(node));
+		case NodeKind::CLASS_TYPE:
+			return self().visitClassType(static_cast<ClassTypeNode *>(node));
+		case NodeKind::PERFECT_TYPE:
+			return self().visitPerfectType(
+			  static_cast<PerfectTypeNode *>(node));
+		case NodeKind::ASSIGN:
+			return self().visitAssign(static_cast<AssignStmtNode *>(node));
+		case NodeKind::CALL_STMT:
+			return self().visitCallStmt(static_cast<CallStmtNode *>(node));
+		case NodeKind::EXIT:
+			return self().visitExit(static_cast<ExitStmtNode *>(node));
+		case NodeKind::GIVE:
+			return self().visitGive(static_cast<GiveStmtNode *>(node));
+		case NodeKind::IF_ELSE:
+			return self().visitIfElse(static_cast<IfElseStmtNode *>(node));
+		case NodeKind::IF:
+			return self().visitIf(static_cast<IfStmtNode *>(node));
+		case NodeKind::POST_DEC:
+			return self().visitPostDec(static_cast<PostDecStmtNode *>(node));
+		case NodeKind::POST_INC:
+			return self().visitPostInc(static_cast<PostIncStmtNode *>(node));
+		case NodeKind::RETURN:
+			return self().visitReturn(static_cast<ReturnStmtNode *>(node));
+		case NodeKind::TAKE:
+			return self().visitTake(static_cast<TakeStmtNode *>(node));
+		case NodeKind::WHILE:
+			return self().visitWhile(static_cast<WhileStmtNode *>(node));
+		case NodeKind::VAR_DECL:
+			return self().visitVarDecl(static_cast<VarDeclNode *>(node));
+		case NodeKind::FORMAL_DECL:
+			return self().visitFormalDecl(
+			  static_cast<FormalDeclNode *>(node));
+		case NodeKind::FN_DECL:
+			return self().visitFnDecl(static_cast<FnDeclNode *>(node));
+		case NodeKind::CLASS_DECL:
+			return self().visitClassDecl(static_cast<ClassDeclNode *>(node));
+		case NodeKind::ID:
+			return self().visitID(static_cast<IDNode *>(node));
+		case NodeKind::MEMBER_FIELD:
+			return self().visitMemberField(
+			  static_cast<MemberFieldExpNode *>(node));
+		case NodeKind::CALL_EXP:
+			return self().visitCallExp(static_cast<CallExpNode *>(node));
+		case NodeKind::FALSE_LIT:
+			return self().visitFalse(static_cast<FalseNode *>(node));
+		case NodeKind::TRUE_LIT:
+			return self().visitTrue(static_cast<TrueNode *>(node));
+		case NodeKind::MAGIC:
+			return self().visitMagic(static_cast<MagicNode *>(node));
+		case NodeKind::INT_LIT:
+			return self().visitIntLit(static_cast<IntLitNode *>(node));
+		case NodeKind::STR_LIT:
+			return self().visitStrLit(static_cast<StrLitNode *>(node));
+		case NodeKind::NEG:
+			return self().visitNeg(static_cast<NegNode *>(node));
+		case NodeKind::NOT:
+			return self().visitNot(static_cast<NotNode *>(node));
+		case NodeKind::AND:
+			return self().visitAnd(static_cast<AndNode *>(node));
+		case NodeKind::DIVIDE:
+			return self().visitDivide(static_cast<DivideNode *>(node));
+		case NodeKind::EQUALS:
+			return self().visitEquals(static_cast<EqualsNode *>(node));
+		case NodeKind::GREATER_EQ:
+			return self().visitGreaterEq(static_cast<GreaterEqNode *>(node));
+		case NodeKind::GREATER:
+			return self().visitGreater(static_cast<GreaterNode *>(node));
+		case NodeKind::LESS:
+			return self().visitLess(static_cast<LessNode *>(node));
+		case NodeKind::LESS_EQ:
+			return self().visitLessEq(static_cast<LessEqNode *>(node));
+		case NodeKind::MINUS:
+			return self().visitMinus(static_cast<MinusNode *>(node));
+		case NodeKind::NOT_EQUALS:
+			return self().visitNotEquals(static_cast<NotEqualsNode *>(node));
+		case NodeKind::OR:
+			return self().visitOr(static_cast<OrNode *>(node));
+		case NodeKind::PLUS:
+			return self().visitPlus(static_cast<PlusNode *>(node));
+		case NodeKind::TIMES:
+			return self().visitTimes(static_cast<TimesNode *>(node));
+		}
+		return self().visitNode(node);
+	}
+
+	/* Categories */
+	Result visitNode(ASTNode *){ return Result(); }
+	Result visitType(TypeNode * n){ return self().visitNode(n); }
+	Result visitStmt(StmtNode * n){ return self().visitNode(n); }
+	Result visitDecl(DeclNode * n){ return self().visitStmt(n); }
+	Result visitExp(ExpNode * n){ return self().visitNode(n); }
+	Result visitLoc(LocNode * n){ return self().visitExp(n); }
+	Result visitUnaryExp(UnaryExpNode * n){ return self().visitExp(n); }
+	Result visitBinaryExp(BinaryExpNode * n){ return self().visitExp(n); }
+
+	/* Concrete classes */
+	Result visitProgram(ProgramNode * n){ return self().visitNode(n); }
+	Result visitIntType(IntTypeNode * n){ return self().visitType(n); }
+	Result visitBoolType(BoolTypeNode * n){ return self().visitType(n); }
+	Result visitVoidType(VoidTypeNode * n){ return self().visitType(n); }
+	Result visitClassType(ClassTypeNode * n){ return self().visitType(n); }
+	Result visitPerfectType(PerfectTypeNode * n){
+		return self().visitType(n);
+	}
+	Result visitAssign(AssignStmtNode * n){ return self().visitStmt(n); }
+	Result visitCallStmt(CallStmtNode * n){ return self().visitStmt(n); }
+	Result visitExit(ExitStmtNode * n){ return self().visitStmt(n); }
+	Result visitGive(GiveStmtNode * n){ return self().visitStmt(n); }
+	Result visitIfElse(IfElseStmtNode * n){ return self().visitStmt(n); }
+	Result visitIf(IfStmtNode * n){ return self().visitStmt(n); }
+	Result visitPostDec(PostDecStmtNode * n){ return self().visitStmt(n); }
+	Result visitPostInc(PostIncStmtNode * n){ return self().visitStmt(n); }
+	Result visitReturn(ReturnStmtNode * n){ return self().visitStmt(n); }
+	Result visitTake(TakeStmtNode * n){ return self().visitStmt(n); }
+	Result visitWhile(WhileStmtNode * n){ return self().visitStmt(n); }
+	Result visitVarDecl(VarDeclNode * n){ return self().visitDecl(n); }
+	Result visitFormalDecl(FormalDeclNode * n){
+		return self().visitDecl(n);
+	}
+	Result visitFnDecl(FnDeclNode * n){ return self().visitDecl(n); }
+	Result visitClassDecl(ClassDeclNode * n){ return self().visitDecl(n); }
+	Result visitID(IDNode * n){ return self().visitLoc(n); }
+	Result visitMemberField(MemberFieldExpNode * n){
+		return self().visitLoc(n);
+	}
+	Result visitCallExp(CallExpNode * n){ return self().visitExp(n); }
+	Result visitFalse(FalseNode * n){ return self().visitExp(n); }
+	Result visitTrue(TrueNode * n){ return self().visitExp(n); }
+	Result visitMagic(MagicNode * n){ return self().visitExp(n); }
+	Result visitIntLit(IntLitNode * n){ return self().visitExp(n); }
+	Result visitStrLit(StrLitNode * n){ return self().visitExp(n); }
+	Result visitNeg(NegNode * n){ return self().visitUnaryExp(n); }
+	Result visitNot(NotNode * n){ return self().visitUnaryExp(n); }
+	Result visitAnd(AndNode * n){ return self().visitBinaryExp(n); }
+	Result visitDivide(DivideNode * n){ return self().visitBinaryExp(n); }
+	Result visitEquals(EqualsNode * n){ return self().visitBinaryExp(n); }
+	Result visitGreaterEq(GreaterEqNode * n){
+		return self().visitBinaryExp(n);
+	}
+	Result visitGreater(GreaterNode * n){ return self().visitBinaryExp(n); }
+	Result visitLess(LessNode * n){ return self().visitBinaryExp(n); }
+	Result visitLessEq(LessEqNode * n){ return self().visitBinaryExp(n); }
+	Result visitMinus(MinusNode * n){ return self().visitBinaryExp(n); }
+	Result visitNotEquals(NotEqualsNode * n){
+		return self().visitBinaryExp(n);
+	}
+	Result visitOr(OrNode * n){ return self().visitBinaryExp(n); }
+	Result visitPlus(PlusNode * n){ return self().visitBinaryExp(n); }
+	Result visitTimes(TimesNode * n){ return self().visitBinaryExp(n); }
+protected:
+	Derived& self(){ return static_cast<Derived&>(*this); }
+};
+
+/* Call f on each child of node that is there, in source order */
+template <typename F>
+void forEachChild(ASTNode * node, F f){
+	auto each = [&f](const auto * list){
+		for (auto child : *list){ f(child); }
+	};
+	auto maybe = [&f](ASTNode * child){
+		if (child != nullptr){ f(child); }
+	};
+	switch (node->kind()){
+	case NodeKind::PROGRAM:
+		each(static_cast<ProgramNode *>(node)->globals());
+		break;
+	case NodeKind::CLASS_TYPE:
+		f(static_cast<ClassTypeNode *>(node)->getID());
+		break;
+	case NodeKind::PERFECT_TYPE:
+		f(static_cast<PerfectTypeNode *>(node)->getType());
+		break;
+	case NodeKind::ASSIGN: {
+		AssignStmtNode * assign = static_cast<AssignStmtNode *>(node);
+		f(assign->getDest());
+		f(assign->getExp());
+		break;
+	}
+	case NodeKind::CALL_STMT:
+		f(static_cast<CallStmtNode *>(node)->getCall());
+		break;
+	case NodeKind::GIVE:
+		f(static_cast<GiveStmtNode *>(node)->getExp());
+		break;
+	case NodeKind::IF_ELSE: {
+		IfElseStmtNode * ifElse = static_cast<IfElseStmtNode *>(node);
+		f(ifElse->getCondition());
+		each(ifElse->getTrueBranch());
+		each(ifElse->getFalseBranch());
+		break;
+	}
+	case NodeKind::IF: {
+		IfStmtNode * ifStmt = static_cast<IfStmtNode *>(node);
+		f(ifStmt->getCondition());
+		each(ifStmt->getStmts());
+		break;
+	}
+	case NodeKind::POST_DEC:
+		f(static_cast<PostDecStmtNode *>(node)->getLoc());
+		break;
+	case NodeKind::POST_INC:
+		f(static_cast<PostIncStmtNode *>(node)->getLoc());
+		break;
+	case NodeKind::RETURN:
+		maybe(static_cast<ReturnStmtNode *>(node)->getExp());
+		break;
+	case NodeKind::TAKE:
+		f(static_cast<TakeStmtNode *>(node)->getLoc());
+		break;
+	case NodeKind::WHILE: {
+		WhileStmtNode * loop = static_cast<WhileStmtNode *>(node);
+		f(loop->getExp());
+		each(loop->getStmts());
+		break;
+	}
+	case NodeKind::VAR_DECL:
+	case NodeKind::FORMAL_DECL: {
+		VarDeclNode * decl = static_cast<VarDeclNode *>(node);
+		f(decl->getID());
+		f(decl->getType());
+		maybe(decl->getExp());
+		break;
+	}
+	case NodeKind::FN_DECL: {
+		FnDeclNode * fn = static_cast<FnDeclNode *>(node);
+		f(fn->getID());
+		each(fn->getDecls());
+		f(fn->getType());
+		each(fn->getStmts());
+		break;
+	}
+	case NodeKind::CLASS_DECL: {
+		ClassDeclNode * cls = static_cast<ClassDeclNode *>(node);
+		f(cls->getName());
+		each(cls->getDecls());
+		break;
+	}
+	case NodeKind::MEMBER_FIELD: {
+		MemberFieldExpNode * field = static_cast<MemberFieldExpNode *>(node);
+		f(field->getLoc());
+		f(field->getName());
+		break;
+	}
+	case NodeKind::CALL_EXP: {
+		CallExpNode * call = static_cast<CallExpNode *>(node);
+		f(call->getFunctionName());
+		each(call->getArgs());
+		break;
+	}
+	case NodeKind::NEG:
+	case NodeKind::NOT:
+		f(static_cast<UnaryExpNode *>(node)->getExp());
+		break;
+	default:
+		if (isBinaryExp(node->kind())){
+			BinaryExpNode * binary = static_cast<BinaryExpNode *>(node);
+			f(binary->getLhs());
+			f(binary->getRhs());
+		}
+		// Everything else is a leaf
+		break;
+	}
+}
+
+/**
+* \class ASTWalker
+* Visits every node of a tree in pre-order. Derived's enter(node) is
+* called first and its children are skipped if it returns false;
+* leave(node) comes after the children. The children are the ones
+* Derived's children(node, f) hands to f, which by default are those
+* of forEachChild, in source order.
+*
+* The walk recurses down to a fixed depth, and below that goes on
+* with a stack of its own, so a tree of any depth can be walked in
+* a bounded native stack; a long chain of binary operators is as
+* deep as it has operands.
+**/
+template <typename Derived>
+class ASTWalker{
+public:
+	void walk(ASTNode * root){ descend(root, 0); }
+	bool enter(ASTNode *){ return true; }
+	void leave(ASTNode *){ }
+	template <typename F>
+	void children(ASTNode * node, F f){ forEachChild(node, f); }
+protected:
+	Derived& self(){ return static_cast<Derived&>(*this); }
+private:
+	/* How deep the walk recurses before it switches to its stack */
+	static const int MAX_DEPTH = 100;
+
+	struct Frame{
+		ASTNode * node;
+		bool entered;    // whether it is waiting only for leave()
+	};
+
+	void descend(ASTNode * node, int depth){
+		if (depth == MAX_DEPTH){
+			walkDeep(node);
+			return;
+		}
+		if (!self().enter(node)){ return; }
+		self().children(node, [this, depth](ASTNode * child){
+			descend(child, depth + 1);
+		});
+		self().leave(node);
+	}
+
+	void walkDeep(ASTNode * root){
+		std::vector<Frame> stack;
+		stack.push_back(Frame{root, false});
+		while (!stack.empty()){
+			Frame frame = stack.back();
+			stack.pop_back();
+			if (frame.entered){
+				self().leave(frame.node);
+				continue;
+			}
+			if (!self().enter(frame.node)){ continue; }
+			stack.push_back(Frame{frame.node, true});
+			size_t first = stack.size();
+			self().children(frame.node, [&stack](ASTNode * child){
+				stack.push_back(Frame{child, false});
+			});
+			// The last pushed is visited first, so turn them around
+			std::reverse(stack.begin() + static_cast<std::ptrdiff_t>(first),
+			  stack.end());
+		}
+	}
+};
+
+/**
+* \class ASTFolder
+* Works out a Result for every node of a tree, bottom up: the visit
+* method of Derived that matches a node's kind gets the Results of
+* the node's children with child() and childList(), and returns the
+* node's own. A null child has Result().
+*
+* Like ASTWalker, this recurses only down to a fixed depth. A deeper
+* subtree is walked with a stack instead, each node visited after
+* all of its children, whose Results child() and childList() then
+* hand out in the order they were walked. Derived must take them in
+* the order its children(node, f) gives, which by default is that
+* of forEachChild.
+**/
+template <typename Derived, typename Result>
+class ASTFolder : public ASTVisitor<Derived, Result>{
+public:
+	/** The Result of root **/
+	Result fold(ASTNode * root){ return child(root); }
+
+	template <typename F>
+	void children(ASTNode * node, F f){ forEachChild(node, f); }
+protected:
+	/** The Result of node, the next child of the node being
+	    visited **/
+	Result child(ASTNode * node){
+		if (node == nullptr){ return Result(); }
+		if (myDeep){ return myResults[myNext++]; }
+		if (myDepth == MAX_DEPTH){ return foldDeep(node); }
+		myDepth++;
+		Result result = this->visit(node);
+		myDepth--;
+		return result;
+	}
+
+	/** The Results of list, the next children of the node being
+	    visited **/
+	template <typename T>
+	std::vector<Result> childList(const NodeList<T *> * list){
+		std::vector<Result> results;
+		results.reserve(list->size());
+		for (T * node : *list){ results.push_back(child(node)); }
+		return results;
+	}
+private:
+	/* How deep folds recurse before they switch to a stack */
+	static const int MAX_DEPTH = 100;
+
+	class Walk : public ASTWalker<Walk>{
+	public:
+		explicit Walk(ASTFolder& folder) : myFolder(folder){ }
+		bool enter(ASTNode *){
+			myFolder.myMarks.push_back(myFolder.myResults.size());
+			return true;
+		}
+		void leave(ASTNode * node){ myFolder.finish(node); }
+		template <typename F>
+		void children(ASTNode * node, F f){
+			myFolder.self().children(node, f);
+		}
+	private:
+		ASTFolder& myFolder;
+	};
+
+	Result foldDeep(ASTNode * root){
+		myDeep = true;
+		Walk(*this).walk(root);
+		myDeep = false;
+		Result result = myResults.back();
+		myResults.clear();
+		return result;
+	}
+
+	/* Replace the Results of node's children with node's own */
+	void finish(ASTNode * node){
+		size_t mark = myMarks.back();
+		myMarks.pop_back();
+		myNext = mark;
+		Result result = this->visit(node);
+		myResults.resize(mark);
+		myResults.push_back(result);
+	}
+
+	int myDepth = 0;
+	bool myDeep = false;
+	std::vector<Result> myResults;  // of the nodes not yet used
+	std::vector<size_t> myMarks;    // where each open node's children begin
+	size_t myNext = 0;
+};
+
+}
+
+#endif
@@ -0,0 +1,93 @@
+#include <cerrno>
+#include <climits>
+#include <unistd.h>
+#include "writer.hpp"
+#include "errors.hpp"
+
+namespace drewno_mars{
+
+/* Enough tabs for any sane nesting depth in one copy */
+static const char TABS[] = 
+  "\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t";
+static const int TABS_LEN = sizeof(TABS) - 1;
+
+Writer::Writer(int fd)
+: myFd(fd), myStream(nullptr), myBuf(new char[CAPACITY]){ }
+
+Writer::Writer(std::ostream& out)
+: myFd(-1), myStream(&out), myBuf(new char[CAPACITY]){ }
+
+Writer::~Writer(){
+	/* Callers that care about write errors flush() themselves;
+	   a destructor must not throw */
+	try {
+		flush();
+	} catch (InternalError * e){
+		delete e;
+	}
+	delete [] myBuf;
+}
+
+/* Format mag right-aligned into a buffer ending at end */
+static char * formatDigits(char * end, size_t mag){
+	char * cur = end;
+	do {
+		*--cur = static_cast<char>('0' + mag % 10);
+		mag /= 10;
+	} while (mag != 0);
+	return cur;
+}
+
+Writer& Writer::operator<<(int value){
+	char digits[24];
+	char * end = digits + sizeof(digits);
+	/* Work with the magnitude as unsigned so INT_MIN is safe */
+	unsigned int mag = value < 0 
+	  ? 0u - static_cast<unsigned int>(value) 
+	  : static_cast<unsigned int>(value);
+	char * cur = formatDigits(end, mag);
+	if (value < 0){ *--cur = '-'; }
+	write(cur, static_cast<size_t>(end - cur));
+	return *this;
+}
+
+Writer& Writer::operator<<(size_t value){
+	char digits[24];
+	char * end = digits + sizeof(digits);
+	char * cur = formatDigits(end, value);
+	write(cur, static_cast<size_t>(end - cur));
+	return *this;
+}
+
+void Writer::indent(int depth){
+	while (depth > TABS_LEN){
+		write(TABS, TABS_LEN);
+		depth -= TABS_LEN;
+	}
+	if (depth > 0){ write(TABS, static_cast<size_t>(depth)); }
+}
+
+void Writer::flush(){
+	if (myLen == 0){ return; }
+	emit(myBuf, myLen);
+	myLen = 0;
+}
+
+void Writer::emit(const char * text, size_t len){
+	myEmitted += len;
+	if (myStream != nullptr){
+		myStream->write(text, static_cast<std::streamsize>(len));
+		return;
+	}
+	while (len > 0){
+		ssize_t n = ::write(myFd, text, len);
+		if (n < 0){
+			if (errno == EINTR){ continue; }
+			throw new InternalError("Failed to write output");
+		}
+		text += n;
+		len -= static_cast<size_t>(n);
+	}
+}
+
+}
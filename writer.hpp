@@ -0,0 +1,79 @@
+#ifndef DREWNO_MARS_WRITER_H
+#define DREWNO_MARS_WRITER_H
+
+#include <cstddef>
+#include <cstring>
+#include <ostream>
+#include <string>
+
+namespace drewno_mars{
+
+/**
+* \class Writer
+* An output sink for the unparser and other large text outputs. Text
+* is appended to one big reusable buffer and handed on with a few 
+* large writes, either to a file descriptor or to a std::ostream. 
+* Indentation and integers are formatted by hand, without going
+* through iostream formatting or locales.
+**/
+class Writer{
+public:
+	/** Write to fd (not closed by the Writer) **/
+	explicit Writer(int fd);
+	/** Write to out, e.g. std::cout or a std::ostringstream **/
+	explicit Writer(std::ostream& out);
+	/** Flushes anything still buffered **/
+	~Writer();
+	Writer(const Writer&) = delete;
+	Writer& operator=(const Writer&) = delete;
+
+	void write(const char * text, size_t len){
+		if (len > CAPACITY - myLen){
+			flush();
+			if (len > CAPACITY){
+				emit(text, len);
+				return;
+			}
+		}
+		std::memcpy(myBuf + myLen, text, len);
+		myLen += len;
+	}
+	Writer& operator<<(const char * text){
+		write(text, std::strlen(text));
+		return *this;
+	}
+	Writer& operator<<(const std::string& text){
+		write(text.data(), text.size());
+		return *this;
+	}
+	Writer& operator<<(char c){
+		if (myLen == CAPACITY){ flush(); }
+		myBuf[myLen++] = c;
+		return *this;
+	}
+	Writer& operator<<(int value);
+	Writer& operator<<(size_t value);
+
+	/** depth tab characters **/
+	void indent(int depth);
+
+	/** Hand everything buffered to the destination **/
+	void flush();
+
+	/** Bytes written so far, counting any still buffered **/
+	size_t written() const { return myEmitted + myLen; }
+private:
+	static const size_t CAPACITY = 256 * 1024;
+
+	void emit(const char * text, size_t len);
+
+	int myFd;
+	std::ostream * myStream;
+	char * myBuf;
+	size_t myLen = 0;
+	size_t myEmitted = 0;
+};
+
+}
+
+#endif